@@ -0,0 +1,73 @@
+import os
+import re
+import json
+import argparse
+import tempfile
+import subprocess
+import numpy as np
+import pandas as pd
+
+def generate_array(num_elements, num_directions, output_dir, seed=42):
+    """ Generate synthetic XYZ coordinates and directions (same distribution as python/generate_synthetic_data.py). """
+    rng = np.random.default_rng(seed)
+    x = rng.uniform(-1000, 1000, num_elements)
+    y = rng.uniform(-1000, 1000, num_elements)
+    z = rng.uniform(-10, 10, num_elements)
+    pd.DataFrame({'x': x, 'y': y, 'z': z}).to_csv(f'{output_dir}/xyz_coordinates.csv', index=False, header=False)
+
+    HAs = rng.uniform(-np.pi, np.pi, num_directions)
+    Decs = rng.uniform(-np.pi / 2, np.pi / 2, num_directions)
+    pd.DataFrame({'HA': HAs, 'Dec': Decs}).to_csv(f'{output_dir}/directions.csv', index=False)
+
+def run_imager(executable, work_dir, backend, gridder, image_size, predefined_max_uv):
+    """ Run RadioImager once in work_dir and return the reported imaging time in ms. """
+    with open(f'{work_dir}/config.json', 'w') as f:
+        json.dump({'IMAGE_SIZE': image_size, 'PREDEFINED_MAX_UV': predefined_max_uv}, f)
+
+    args = [
+        executable,
+        f'--backend={backend}',
+        f'--gridder={gridder}',
+        f'--input={work_dir}/xyz_coordinates.csv',
+        f'--directions={work_dir}/directions.csv',
+        '--use_predefined_params=true',
+        '--output_uvw=false',
+        '--save_images=false',
+    ]
+    result = subprocess.run(args, cwd=work_dir, check=True, capture_output=True, text=True)
+    match = re.search(r'Imaging complete.*Execution time: (\d+) ms', result.stdout)
+    return int(match.group(1))
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the scatter and tiled gridders of RadioImager.")
+    parser.add_argument('--executable', type=str, default='build/RadioImager', help='Path to the RadioImager executable.')
+    parser.add_argument('--backend', type=str, default='cuda', help='Backend to benchmark (cuda or cpu).')
+    parser.add_argument('--elements', type=int, nargs='+', default=[100, 250, 500, 1000, 2000], help='Antenna counts to sweep.')
+    parser.add_argument('--image_sizes', type=int, nargs='+', default=[256, 512, 1024], help='IMAGE_SIZE values to sweep.')
+    parser.add_argument('--num_directions', type=int, default=10, help='Number of directions per run.')
+    parser.add_argument('--repeats', type=int, default=3, help='Number of runs per configuration (the minimum is reported).')
+    parser.add_argument('--output', type=str, default='analysis/gridder_timings.csv', help='Output CSV file.')
+    args = parser.parse_args()
+
+    executable = os.path.abspath(args.executable)
+    with open('config.json', 'r') as f:
+        predefined_max_uv = json.load(f)['PREDEFINED_MAX_UV']
+
+    rows = []
+    with tempfile.TemporaryDirectory() as work_dir:
+        for num_elements in args.elements:
+            generate_array(num_elements, args.num_directions, work_dir)
+            for image_size in args.image_sizes:
+                for gridder in ('scatter', 'tiled'):
+                    times = [run_imager(executable, work_dir, args.backend, gridder, image_size, predefined_max_uv)
+                             for _ in range(args.repeats)]
+                    rows.append({'num_elements': num_elements, 'num_directions': args.num_directions,
+                                 'image_size': image_size, 'backend': args.backend, 'gridder': gridder,
+                                 'imaging_time': min(times)})
+                    print(f'{num_elements} elements, image size {image_size}, {gridder}: {min(times)} ms')
+
+    pd.DataFrame(rows).to_csv(args.output, index=False)
+    print(f'Timings saved to {args.output}')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,99 @@
+// include/async_writer.hpp
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Background thread that runs write tasks in submission order.
+ *
+ * Tasks are queued in a bounded queue: submit() blocks while `capacity` tasks are
+ * pending, so a producer that images faster than the disk can write never holds more
+ * than `capacity` finished batches in memory. finish() (or the destructor) waits for
+ * all queued tasks and stops the thread.
+ */
+class AsyncWriter {
+public:
+    explicit AsyncWriter(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~AsyncWriter() { finish(); }
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    /**
+     * @brief Queue a task, waiting while the queue is full.
+     */
+    void submit(std::function<void()> task) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]() { return tasks_.size() < capacity_; });
+        tasks_.push_back(std::move(task));
+        not_empty_.notify_one();
+    }
+
+    /**
+     * @brief Run all queued tasks and stop the writer thread.
+     */
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        not_empty_.notify_one();
+        thread_.join();
+    }
+
+    /**
+     * @brief Time the writer thread spent running tasks, in milliseconds.
+     */
+    double busyMilliseconds() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return busy_ms_;
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+                not_full_.notify_one();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            task();
+            auto stop = std::chrono::high_resolution_clock::now();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ms_ += std::chrono::duration<double, std::milli>(stop - start).count();
+        }
+    }
+
+    size_t capacity_;
+    std::deque<std::function<void()>> tasks_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    bool stopping_ = false;
+    double busy_ms_ = 0.0;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,79 @@
+// include/backend.hpp
+#ifndef BACKEND_HPP
+#define BACKEND_HPP
+
+#include "gridding.hpp"
+#include "gridding_plan.hpp"
+#include "wstacking.hpp"
+#include "precision.hpp"
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+
+class VisibilityStream;
+
+/**
+ * @brief Common interface implemented by every imaging engine (CUDA, native CPU).
+ *
+ * Both engines follow the same contract as the original free functions: UVW
+ * coordinates are returned per direction, one baseline per entry, and images are
+ * returned per direction as row-major image_size x image_size buffers normalized
+ * by their maximum absolute value.
+ *
+ * computeUVW and uniformImage have one overload per Precision: double, float, and
+ * mixed (double UVW coordinates with float visibilities, grids and images).
+ * Gridding plans, w-stacking and streamed imaging are double precision only.
+ *
+ * streamImage grids the blocks of a VisibilityStream one after the other into
+ * per-direction grids that stay resident across blocks, so the size of the
+ * visibility data is not limited by memory.
+ */
+class ImagingBackend {
+public:
+    virtual ~ImagingBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    virtual void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                            const std::vector<double>& HAs, const std::vector<double>& Decs,
+                            std::vector<std::vector<double>>& u, std::vector<std::vector<double>>& v, std::vector<std::vector<double>>& w) = 0;
+
+    virtual void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                            const std::vector<double>& HAs, const std::vector<double>& Decs,
+                            std::vector<std::vector<float>>& u, std::vector<std::vector<float>>& v, std::vector<std::vector<float>>& w) = 0;
+
+    virtual void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                              const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                              int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                              GridderMode gridder) = 0;
+
+    virtual void uniformImage(const std::vector<std::vector<std::complex<float>>>& visibilities_batch,
+                              const std::vector<std::vector<float>>& u_batch, const std::vector<std::vector<float>>& v_batch,
+                              int image_size, std::vector<std::vector<float>>& images, bool use_predefined_params,
+                              GridderMode gridder) = 0;
+
+    virtual void uniformImage(const std::vector<std::vector<std::complex<float>>>& visibilities_batch,
+                              const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                              int image_size, std::vector<std::vector<float>>& images, bool use_predefined_params,
+                              GridderMode gridder) = 0;
+
+    virtual void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                           std::vector<std::vector<double>>& images) = 0;
+
+    virtual void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                             const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                             const std::vector<std::vector<double>>& w_batch,
+                             int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                             int num_w_planes, std::vector<WPlaneTiming>& plane_timings) = 0;
+
+    virtual void streamImage(VisibilityStream& stream, int image_size, double max_uv,
+                             std::vector<std::vector<double>>& images) = 0;
+};
+
+// Factory functions
+std::unique_ptr<ImagingBackend> makeCudaBackend();
+std::unique_ptr<ImagingBackend> makeCpuBackend(unsigned num_threads);
+std::unique_ptr<ImagingBackend> makeBackend(const std::string& name, unsigned num_threads);
+
+#endif
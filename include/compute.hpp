@@ -2,6 +2,9 @@
 #ifndef COMPUTE_HPP
 #define COMPUTE_HPP
 
+#include "gridding.hpp"
+#include "gridding_plan.hpp"
+#include "wstacking.hpp"
 #include <cufft.h>
 #include <thrust/complex.h>
 #include <thrust/device_vector.h>
@@ -9,18 +12,116 @@
 #include <cmath>
 #include <algorithm>
 #include <vector>
+#include <map>
+#include <utility>
+#include <complex>
 
-// Function declarations
-void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
-                  const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
-                  int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params);
+class VisibilityStream;
 
-__global__ void mapVisibilitiesMultiDir(cufftDoubleComplex* grid, const cufftDoubleComplex* visibilities, const double* u, const double* v, double uv_max, double grid_res, int image_size, int num_visibilities, int num_directions);
+/**
+ * @brief cuFFT complex type and transform type of a precision.
+ */
+template <typename Real>
+struct CufftTypes;
 
-void fftshift(thrust::device_vector<cufftDoubleComplex>& data, int width, int height);
+template <>
+struct CufftTypes<float> {
+    using Complex = cufftComplex;
+    static constexpr cufftType C2C = CUFFT_C2C;
+};
 
+template <>
+struct CufftTypes<double> {
+    using Complex = cufftDoubleComplex;
+    static constexpr cufftType C2C = CUFFT_Z2Z;
+};
+
+// Function declarations (uniformImage is instantiated for (UVWReal, GridReal) =
+// (double, double), (float, float) and (double, float), see Precision)
+template <typename UVWReal, typename GridReal>
+void uniformImage(const std::vector<std::vector<std::complex<GridReal>>>& visibilities_batch,
+                  const std::vector<std::vector<UVWReal>>& u_batch, const std::vector<std::vector<UVWReal>>& v_batch,
+                  int image_size, std::vector<std::vector<GridReal>>& images, bool use_predefined_params,
+                  GridderMode gridder = GridderMode::Scatter);
+
+void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+               std::vector<std::vector<double>>& images);
+
+void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                 const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                 const std::vector<std::vector<double>>& w_batch,
+                 int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                 int num_w_planes, std::vector<WPlaneTiming>& plane_timings);
+
+void streamImage(VisibilityStream& stream, int image_size, double max_uv, std::vector<std::vector<double>>& images);
+
+template <typename UVWReal, typename GridReal>
+__global__ void mapVisibilitiesMultiDir(typename CufftTypes<GridReal>::Complex* grid, const typename CufftTypes<GridReal>::Complex* visibilities,
+                                        const UVWReal* u, const UVWReal* v, UVWReal uv_max, UVWReal grid_res,
+                                        int image_size, int num_visibilities, int num_directions);
+
+/**
+ * @brief CUDA FFT stage of the imaging pipeline (CpuFFTEngine in fft_engine.hpp is the native counterpart).
+ *
+ * Keeps one batched cuFFT plan per (image size, number of directions) and the device
+ * workspaces for the real images, and reuses them across calls. Both fftshifts are
+ * folded into the gridding layout and the image extraction, and normalization and
+ * max-reduction run on the device, so only real images are copied back. Instantiated
+ * for float (C2C) and double (Z2Z).
+ */
+template <typename Real>
+class CudaFFTEngine {
+public:
+    using Complex = typename CufftTypes<Real>::Complex;
+
+    ~CudaFFTEngine();
+
+    void inverse(Complex* d_grids, int num_directions, int image_size);
+    void toImages(Complex* d_grids, int num_directions, int image_size, std::vector<std::vector<Real>>& images);
+    void extractImages(const Complex* d_grids, int num_directions, int image_size, std::vector<std::vector<Real>>& images);
+    void release();
+
+private:
+    cufftHandle planFor(int image_size, int num_directions);
+
+    std::map<std::pair<int, int>, cufftHandle> plans_;
+    Real* d_images_ = nullptr;
+    Real* d_partial_max_ = nullptr;
+    size_t images_capacity_ = 0;
+    size_t partial_max_capacity_ = 0;
+};
+
+template <typename Real>
+CudaFFTEngine<Real>& cudaFFTEngine();
+
+/**
+ * @brief Device buffers of uniformImage (grids, u and v) kept across calls.
+ *
+ * Each slot grows to the next power of two of the requested size and is never
+ * shrunk, so calls of similar sizes (e.g. the requests of --serve) reuse the same
+ * allocation. release() frees the buffers (before cudaDeviceReset).
+ */
+class CudaWorkspace {
+public:
+    enum Slot { Grids, U, V, NumSlots };
+
+    ~CudaWorkspace();
+
+    void* buffer(Slot slot, size_t bytes);
+    cudaStream_t stream();
+    void release();
+
+private:
+    void* buffers_[NumSlots] = {nullptr, nullptr, nullptr};
+    size_t capacities_[NumSlots] = {0, 0, 0};
+    cudaStream_t stream_ = nullptr;
+};
+
+CudaWorkspace& cudaWorkspace();
+
+template <typename Real>
 void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m, 
                 const std::vector<double>& HAs, const std::vector<double>& Decs, 
-                std::vector<std::vector<double>>& u, std::vector<std::vector<double>>& v, std::vector<std::vector<double>>& w);
+                std::vector<std::vector<Real>>& u, std::vector<std::vector<Real>>& v, std::vector<std::vector<Real>>& w);
 
 #endif
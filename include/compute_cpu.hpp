@@ -0,0 +1,51 @@
+// include/compute_cpu.hpp
+#ifndef COMPUTE_CPU_HPP
+#define COMPUTE_CPU_HPP
+
+#include "gridding.hpp"
+#include "gridding_plan.hpp"
+#include "wstacking.hpp"
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+class VisibilityStream;
+
+/**
+ * @namespace cpu
+ * @brief Native multithreaded C++ implementation of the imaging pipeline.
+ */
+namespace cpu {
+
+// Function declarations (instantiated for Real = float, double and for
+// (UVWReal, GridReal) = (double, double), (float, float), (double, float))
+template <typename Real>
+void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                const std::vector<double>& HAs, const std::vector<double>& Decs,
+                std::vector<std::vector<Real>>& u, std::vector<std::vector<Real>>& v, std::vector<std::vector<Real>>& w,
+                unsigned num_threads);
+
+template <typename UVWReal, typename GridReal>
+void uniformImage(const std::vector<std::vector<std::complex<GridReal>>>& visibilities_batch,
+                  const std::vector<std::vector<UVWReal>>& u_batch, const std::vector<std::vector<UVWReal>>& v_batch,
+                  int image_size, std::vector<std::vector<GridReal>>& images, bool use_predefined_params,
+                  GridderMode gridder, unsigned num_threads);
+
+void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+               std::vector<std::vector<double>>& images, unsigned num_threads);
+
+void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                 const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                 const std::vector<std::vector<double>>& w_batch,
+                 int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                 int num_w_planes, std::vector<WPlaneTiming>& plane_timings, unsigned num_threads);
+
+void streamImage(VisibilityStream& stream, int image_size, double max_uv,
+                 std::vector<std::vector<double>>& images, unsigned num_threads);
+
+void countingSort(const std::vector<int>& bins, int num_bins, unsigned num_threads,
+                  std::vector<size_t>& offsets, std::vector<size_t>& order);
+
+}
+
+#endif
@@ -3,11 +3,13 @@
 #define CONFIG_HPP
 
 #include <fstream>
+#include <string>
 #include <nlohmann/json.hpp>
 
 namespace config {
     extern int IMAGE_SIZE;
     extern double PREDEFINED_MAX_UV;
+    extern std::string PRECISION;
 
     void load_config(const std::string& config_file);
 }
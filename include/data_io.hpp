@@ -2,6 +2,7 @@
 #ifndef DATA_IO_HPP
 #define DATA_IO_HPP
 
+#include <cstddef>
 #include <vector>
 #include <string>
 
@@ -16,13 +17,28 @@ void readDirections(const std::string& filename,
                     std::vector<double>& Decs);
 
 
-void saveUVWCoordinates(const std::vector<std::vector<double>>& u, 
-                        const std::vector<std::vector<double>>& v, 
-                        const std::vector<std::vector<double>>& w, 
+template <typename Real>
+void saveUVWCoordinates(const std::vector<std::vector<Real>>& u, 
+                        const std::vector<std::vector<Real>>& v, 
+                        const std::vector<std::vector<Real>>& w, 
                         const std::string& directory);
 
-void saveImages(const std::vector<std::vector<double>>& images, 
+template <typename Real>
+void saveImages(const std::vector<std::vector<Real>>& images, 
                 int image_size, 
                 const std::string& directory);
 
+template <typename Real>
+bool saveUVWCoordinatesCSV(const std::vector<Real>& u, 
+                           const std::vector<Real>& v, 
+                           const std::vector<Real>& w, 
+                           const std::string& directory, 
+                           size_t direction);
+
+template <typename Real>
+bool saveImageCSV(const std::vector<Real>& image, 
+                  int image_size, 
+                  const std::string& directory, 
+                  size_t index);
+
 #endif
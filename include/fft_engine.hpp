@@ -0,0 +1,52 @@
+// include/fft_engine.hpp
+#ifndef FFT_ENGINE_HPP
+#define FFT_ENGINE_HPP
+
+#include <complex>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+template <typename Real>
+struct Fft1dPlan;
+
+/**
+ * @brief Native FFT stage of the imaging pipeline.
+ *
+ * Turns gridded visibilities (stored in the layout produced by gridStorageIndex /
+ * gridStorageSign) into normalized real images: unnormalized inverse 2D FFT, real
+ * part extraction with the final fftshift folded in, max-reduction and
+ * normalization. 1D plans (twiddles, bit reversal, Bluestein chirps) are built once
+ * per length and cached, so the per-direction cost is the transform itself.
+ *
+ * The engine is instantiated for float and double (see Precision); each precision
+ * has its own plans. The CUDA backend has the same stage in CudaFFTEngine
+ * (include/compute.hpp).
+ */
+template <typename Real>
+class CpuFFTEngine {
+public:
+    void transform(std::complex<Real>* grid, int image_size, bool inverse, unsigned num_threads);
+
+    void toImage(std::complex<Real>* grid, int image_size, Real* image, unsigned num_threads);
+
+    void extractImage(const std::complex<Real>* grid, int image_size, Real* image);
+
+    void toImages(std::vector<std::complex<Real>>& grids, int num_directions, int image_size,
+                  std::vector<std::vector<Real>>& images, unsigned num_threads);
+
+    void clear();
+
+private:
+    std::shared_ptr<const Fft1dPlan<Real>> planFor(int length, bool inverse);
+
+    std::mutex mutex_;
+    std::map<std::pair<int, bool>, std::shared_ptr<const Fft1dPlan<Real>>> plans_;
+};
+
+template <typename Real>
+CpuFFTEngine<Real>& cpuFFTEngine();
+
+#endif
@@ -0,0 +1,147 @@
+// include/gridding.hpp
+#ifndef GRIDDING_HPP
+#define GRIDDING_HPP
+
+#include <string>
+
+#ifdef __CUDACC__
+#define GRID_HOST_DEVICE __host__ __device__
+#else
+#define GRID_HOST_DEVICE
+#endif
+
+/**
+ * @brief Strategy used to accumulate visibilities onto the uv grid.
+ *
+ * - Scatter: every visibility is added to its cell independently (atomics on the GPU,
+ *   per-thread private grids on the CPU).
+ * - Tiled: visibilities are first binned by uv tile with a counting sort, then each
+ *   tile is accumulated by a single worker and written back once, without atomics.
+ */
+enum class GridderMode {
+    Scatter,
+    Tiled
+};
+
+/// Edge length (in grid cells) of the square tiles used by the tiled gridder.
+constexpr int GRID_TILE_SIZE = 16;
+
+/**
+ * @brief Compute the uv grid extent and cell size for a given maximum uv distance.
+ *
+ * Shared by all gridders and by the gridding plan so that every path maps a
+ * baseline to the same grid cell.
+ *
+ * @param max_uv Maximum UV distance (PREDEFINED_MAX_UV or the maximum u of the first direction).
+ * @param image_size Size of the output image.
+ * @param uv_max Output maximum UV coordinate value covered by the grid.
+ * @param grid_res Output resolution of the grid.
+ */
+inline void gridParameters(double max_uv, int image_size, double& uv_max, double& grid_res) {
+    double pixel_resolution = (0.20 / max_uv) / 3;
+    double uv_resolution = 1 / (image_size * pixel_resolution);
+    uv_max = uv_resolution * image_size / 2;
+    grid_res = 2 * uv_max / image_size;
+}
+
+/**
+ * @brief Grid cell (row-major index) of a visibility, or -1 if it is not gridded.
+ *
+ * Uses the same index arithmetic as the mapVisibilitiesMultiDir CUDA kernel,
+ * including the wrap-around of out-of-range indices and skipping of zero baselines.
+ * The arithmetic is done in Real, so float UVW coordinates are binned in single precision.
+ *
+ * @param u U coordinate of the visibility.
+ * @param v V coordinate of the visibility.
+ * @param uv_max Maximum UV coordinate value.
+ * @param grid_res Resolution of the grid.
+ * @param image_size Size of the output image.
+ * @return int Cell index, or -1 if the visibility is skipped.
+ */
+template <typename Real>
+GRID_HOST_DEVICE inline int gridCellIndex(Real u, Real v, Real uv_max, Real grid_res, int image_size) {
+    if (u == Real(0) && v == Real(0)) {
+        return -1;
+    }
+
+    int i_index = static_cast<int>((u + uv_max) / grid_res);
+    int j_index = static_cast<int>((v + uv_max) / grid_res);
+    i_index = (i_index + image_size) % image_size;
+    j_index = (j_index + image_size) % image_size;
+
+    if (i_index < 0 || j_index < 0 || i_index >= image_size || j_index >= image_size) {
+        return -1;
+    }
+    return i_index * image_size + j_index;
+}
+
+/**
+ * @brief Storage index of grid cell (i, j) in the layout expected by the FFT engine.
+ *
+ * The imaging pipeline computes fftshift(ifft2(fftshift(grid))). Gridders fold the
+ * first shift into the way they store the grid: for even sizes a cell stays in place
+ * and is multiplied by gridStorageSign (checkerboard modulation), for odd sizes it is
+ * stored at its shifted position. The FFT engine folds the second shift into the
+ * extraction of the real image (see imageSourceIndex).
+ *
+ * @param i Row of the cell (u axis).
+ * @param j Column of the cell (v axis).
+ * @param image_size Size of the grid.
+ * @return int Row-major storage index.
+ */
+GRID_HOST_DEVICE inline int gridStorageIndex(int i, int j, int image_size) {
+    if (image_size % 2 == 0) {
+        return i * image_size + j;
+    }
+    int shift = image_size / 2;
+    return ((i + shift) % image_size) * image_size + (j + shift) % image_size;
+}
+
+/**
+ * @brief Factor applied to the visibilities of grid cell (i, j): (-1)^(i+j) for even sizes, 1 otherwise.
+ */
+GRID_HOST_DEVICE inline double gridStorageSign(int i, int j, int image_size) {
+    return (image_size % 2 == 0 && ((i + j) & 1)) ? -1.0 : 1.0;
+}
+
+/**
+ * @brief Index of the FFT output element that holds image pixel (k, l).
+ *
+ * For even sizes the pixel is the element itself, multiplied by imageSourceSign; for
+ * odd sizes it is the element the final fftshift would have moved to (k, l).
+ */
+GRID_HOST_DEVICE inline int imageSourceIndex(int k, int l, int image_size) {
+    if (image_size % 2 == 0) {
+        return k * image_size + l;
+    }
+    int shift = (image_size + 1) / 2;
+    return ((k + shift) % image_size) * image_size + (l + shift) % image_size;
+}
+
+/**
+ * @brief Factor applied to FFT output element of pixel (k, l): (-1)^(k+l) for even sizes, 1 otherwise.
+ */
+GRID_HOST_DEVICE inline double imageSourceSign(int k, int l, int image_size) {
+    return (image_size % 2 == 0 && ((k + l) & 1)) ? -1.0 : 1.0;
+}
+
+/**
+ * @brief Parse a gridder name ("scatter" or "tiled").
+ *
+ * @param name Gridder name.
+ * @param mode Parsed gridder mode.
+ * @return true if the name is valid.
+ */
+inline bool parseGridderMode(const std::string& name, GridderMode& mode) {
+    if (name == "scatter") {
+        mode = GridderMode::Scatter;
+        return true;
+    }
+    if (name == "tiled") {
+        mode = GridderMode::Tiled;
+        return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,50 @@
+// include/gridding_plan.hpp
+#ifndef GRIDDING_PLAN_HPP
+#define GRIDDING_PLAN_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Precomputed baseline -> grid cell mapping for a fixed array and direction list.
+ *
+ * For every direction the plan stores, in CSR form, the baselines that fall into each
+ * grid cell: the baselines of cell c are baselineIndices(d)[cellOffsets(d)[c] ..
+ * cellOffsets(d)[c + 1]). Gridding a new visibility set then becomes a gather-sum
+ * over the plan, without recomputing UVW coordinates or cell indices.
+ *
+ * Plans are identified by a hash of the antenna positions, the directions,
+ * IMAGE_SIZE and the maximum uv setting, and can be persisted to disk.
+ */
+class GriddingPlan {
+public:
+    static std::uint64_t computeKey(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                                    const std::vector<double>& HAs, const std::vector<double>& Decs,
+                                    int image_size, bool use_predefined_params, double predefined_max_uv);
+
+    static std::string cachePath(const std::string& directory, std::uint64_t key);
+
+    void build(const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+               int image_size, double max_uv, std::uint64_t key, unsigned num_threads);
+
+    bool load(const std::string& filename, std::uint64_t expected_key);
+    bool save(const std::string& filename) const;
+
+    std::uint64_t key() const { return key_; }
+    int imageSize() const { return image_size_; }
+    int numDirections() const { return static_cast<int>(cell_offsets_.size()); }
+    size_t numBaselines() const { return num_baselines_; }
+
+    const std::vector<std::uint32_t>& cellOffsets(int direction) const { return cell_offsets_[direction]; }
+    const std::vector<std::uint32_t>& baselineIndices(int direction) const { return baseline_indices_[direction]; }
+
+private:
+    std::uint64_t key_ = 0;
+    int image_size_ = 0;
+    size_t num_baselines_ = 0;
+    std::vector<std::vector<std::uint32_t>> cell_offsets_;
+    std::vector<std::vector<std::uint32_t>> baseline_indices_;
+};
+
+#endif
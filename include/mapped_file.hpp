@@ -0,0 +1,38 @@
+// include/mapped_file.hpp
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief A file mapped into memory with mmap.
+ *
+ * Files are either mapped read-only (openRead) or created with a fixed size and
+ * mapped for writing (create), so that a whole output cube can be preallocated
+ * once and filled in place. The mapping is released by close() or the destructor.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool openRead(const std::string& filename);
+    bool create(const std::string& filename, size_t size);
+    void close();
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return fd_ >= 0; }
+
+private:
+    int fd_ = -1;
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,131 @@
+// include/output_writer.hpp
+#ifndef OUTPUT_WRITER_HPP
+#define OUTPUT_WRITER_HPP
+
+#include "mapped_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @brief File format of the saved images and UVW coordinates.
+ *
+ * - Csv: one text file per direction (the original format).
+ * - Raw: one little-endian cube with a 64-byte header (see CubeFile).
+ * - Npy: one NumPy .npy cube.
+ * - Fits: one FITS primary HDU cube (big-endian IEEE floats).
+ */
+enum class OutputFormat {
+    Csv,
+    Raw,
+    Npy,
+    Fits
+};
+
+/// Number of queued write tasks (UVW coordinates or image batches) the writer thread may hold.
+constexpr size_t OUTPUT_QUEUE_CAPACITY = 4;
+
+bool parseOutputFormat(const std::string& name, OutputFormat& format);
+const char* outputFormatExtension(OutputFormat format);
+
+/**
+ * @brief Preallocated memory-mapped 3-D array of Real in raw, npy or FITS layout.
+ *
+ * The file is sized for the whole cube when it is created, so slices can be stored
+ * in any order and from any thread that owns them. Element (i, j, k) of a
+ * dim0 x dim1 x dim2 cube lives at index (i * dim1 + j) * dim2 + k.
+ *
+ * The raw header is 64 bytes: the magic "RIMGCUBE", uint32 version, uint32 element
+ * size (4 or 8), uint64 dim0, dim1, dim2, zero padding; all little-endian.
+ */
+template <typename Real>
+class CubeFile {
+public:
+    bool create(const std::string& filename, OutputFormat format, size_t dim0, size_t dim1, size_t dim2);
+    void close() { file_.close(); }
+
+    /**
+     * @brief Store one element (converted to the byte order of the format).
+     */
+    void store(size_t index, Real value) {
+        char bytes[sizeof(Real)];
+        std::memcpy(bytes, &value, sizeof(Real));
+        if (swap_bytes_) {
+            for (size_t b = 0; b < sizeof(Real) / 2; ++b) {
+                char tmp = bytes[b];
+                bytes[b] = bytes[sizeof(Real) - 1 - b];
+                bytes[sizeof(Real) - 1 - b] = tmp;
+            }
+        }
+        std::memcpy(file_.data() + header_size_ + index * sizeof(Real), bytes, sizeof(Real));
+    }
+
+    /**
+     * @brief Store a contiguous run of elements starting at index.
+     */
+    void store(size_t index, const Real* values, size_t count) {
+        if (!swap_bytes_) {
+            std::memcpy(file_.data() + header_size_ + index * sizeof(Real), values, count * sizeof(Real));
+            return;
+        }
+        for (size_t k = 0; k < count; ++k) {
+            store(index + k, values[k]);
+        }
+    }
+
+    const std::string& filename() const { return filename_; }
+
+private:
+    MappedFile file_;
+    std::string filename_;
+    size_t header_size_ = 0;
+    bool swap_bytes_ = false;
+};
+
+/**
+ * @brief Writes the images of all directions in the selected format.
+ *
+ * CSV writes image_data_gpu_<d>.csv per direction; the binary formats write one
+ * images.<ext> cube of num_images x image_size x image_size. write() may be called
+ * for the directions in any order, from the writer thread.
+ */
+template <typename Real>
+class ImageWriter {
+public:
+    bool open(OutputFormat format, const std::string& directory, size_t num_images, int image_size);
+    void write(size_t index, const std::vector<Real>& image);
+    void close(bool report = true);
+    std::string location() const;
+
+private:
+    OutputFormat format_ = OutputFormat::Csv;
+    std::string directory_;
+    size_t num_images_ = 0;
+    int image_size_ = 0;
+    CubeFile<Real> cube_;
+};
+
+/**
+ * @brief Writes the UVW coordinates of all directions in the selected format.
+ *
+ * CSV writes uvw_coordinates_<d>.csv per direction; the binary formats write one
+ * uvw_coordinates.<ext> cube of num_directions x num_baselines x 3 (u, v, w).
+ */
+template <typename Real>
+class UVWWriter {
+public:
+    bool open(OutputFormat format, const std::string& directory, size_t num_directions, size_t num_baselines);
+    void write(size_t direction, const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w);
+    void close();
+
+private:
+    OutputFormat format_ = OutputFormat::Csv;
+    std::string directory_;
+    size_t num_directions_ = 0;
+    size_t num_baselines_ = 0;
+    CubeFile<Real> cube_;
+};
+
+#endif
@@ -0,0 +1,61 @@
+// include/parallel.hpp
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Resolve a requested thread count, where 0 means "all hardware threads".
+ *
+ * @param requested Requested number of threads.
+ * @return unsigned Number of threads to use (at least 1).
+ */
+inline unsigned resolveThreadCount(unsigned requested) {
+    if (requested > 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+/**
+ * @brief Split [0, count) into contiguous blocks and run them on separate threads.
+ *
+ * The body is called as body(begin, end, worker) where worker is the index of the
+ * block in [0, number of workers). The last block runs on the calling thread.
+ *
+ * @param count Number of items to process.
+ * @param num_threads Maximum number of threads to use (0 = all hardware threads).
+ * @param body Callable invoked once per block.
+ */
+template <typename Body>
+void parallelFor(size_t count, unsigned num_threads, Body&& body) {
+    if (count == 0) return;
+    size_t workers = std::min<size_t>(resolveThreadCount(num_threads), count);
+    if (workers == 1) {
+        body(size_t(0), count, size_t(0));
+        return;
+    }
+
+    size_t block = count / workers;
+    size_t remainder = count % workers;
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    size_t begin = 0;
+    for (size_t t = 0; t < workers; ++t) {
+        size_t end = begin + block + (t < remainder ? 1 : 0);
+        if (t == workers - 1) {
+            body(begin, end, t);
+        } else {
+            threads.emplace_back([&body, begin, end, t]() { body(begin, end, t); });
+        }
+        begin = end;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif
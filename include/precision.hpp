@@ -0,0 +1,44 @@
+// include/precision.hpp
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include <string>
+
+/**
+ * @brief Floating-point precision of the imaging pipeline.
+ *
+ * - Double: UVW coordinates, grids, FFTs and images in double precision.
+ * - Float: everything in single precision (half the memory and bandwidth).
+ * - Mixed: double precision UVW coordinates (so every visibility lands in the same
+ *   cell as in the double pipeline) with single precision grids, FFTs and images.
+ */
+enum class Precision {
+    Double,
+    Float,
+    Mixed
+};
+
+/**
+ * @brief Parse a precision name ("double", "float" or "mixed").
+ *
+ * @param name Precision name.
+ * @param precision Parsed precision.
+ * @return true if the name is valid.
+ */
+inline bool parsePrecision(const std::string& name, Precision& precision) {
+    if (name == "double") {
+        precision = Precision::Double;
+        return true;
+    }
+    if (name == "float") {
+        precision = Precision::Float;
+        return true;
+    }
+    if (name == "mixed") {
+        precision = Precision::Mixed;
+        return true;
+    }
+    return false;
+}
+
+#endif
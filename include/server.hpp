@@ -0,0 +1,148 @@
+// include/server.hpp
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "backend.hpp"
+#include "output_writer.hpp"
+#include "work_stealing_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Settings of the persistent imaging server (--serve).
+ */
+struct ServeOptions {
+    std::string endpoint;          ///< "stdin", "fifo:<path>" or "unix:<path>"
+    std::string backend_name;      ///< cuda or cpu
+    unsigned num_workers;          ///< Worker threads (0 = all hardware threads)
+    unsigned num_threads;          ///< Threads of the cpu backend, split across the workers (0 = all hardware threads)
+    size_t batch_directions;       ///< Directions per worker task
+    int image_size;                ///< Default image size of a request
+    bool use_predefined_params;
+    GridderMode gridder;
+    bool save_images;
+    std::string image_dir;         ///< Images of request n are saved to <image_dir>/request_<n>
+    OutputFormat format;
+    size_t memory_budget_mb;       ///< Memory budget of visibility file requests
+};
+
+/**
+ * @brief Latencies of the finished requests and their percentiles.
+ *
+ * The most recent LATENCY_WINDOW latencies are kept, so the percentiles follow the
+ * current load of a long-running server.
+ */
+class LatencyStats {
+public:
+    static constexpr size_t LATENCY_WINDOW = 4096;
+
+    void record(double milliseconds);
+    double percentile(double p) const;
+    size_t count() const { return count_; }
+
+private:
+    std::vector<double> window_;
+    size_t next_ = 0;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief Persistent imaging server: the array geometry is loaded once and every request reuses it.
+ *
+ * Requests are JSON lines read from stdin, a FIFO or a Unix socket:
+ *
+ *     {"id": "a", "directions": [[ha, dec], ...], "image_size": 256}
+ *     {"id": "b", "visibilities": "data/vis.bin"}
+ *     {"command": "stats"}
+ *     {"command": "shutdown"}
+ *
+ * A direction request is split into tasks of batch_directions directions that are
+ * spread over a WorkStealingPool. Every worker keeps its UVW, visibility and image
+ * buffers in workspaces bucketed by (directions per task, image size), so requests
+ * of a known shape allocate nothing on the host; the backends keep their grids and
+ * FFT plans across calls (CudaWorkspace, cudaFFTEngine, cpuFFTEngine). The cpu
+ * backend has one engine per worker; the cuda backend is shared by the workers and
+ * its calls are serialized, so the workers overlap the device work with UVW
+ * buffers, request parsing and image output.
+ *
+ * Each request is answered with one JSON line holding its latency and the p50, p95
+ * and p99 latencies of the recent requests. Responses go to the socket connection
+ * of the request, or to stdout for stdin and FIFO endpoints; logs go to stderr.
+ */
+class ImagingServer {
+public:
+    ImagingServer(const ServeOptions& options,
+                  const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m);
+    ~ImagingServer();
+
+    bool init();
+    int run();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Responder = std::function<void(const std::string&)>;
+
+    struct Request;
+
+    /// Host buffers of one task shape, reused by every task of that shape.
+    struct Workspace {
+        std::vector<double> HAs, Decs;
+        std::vector<std::vector<double>> u, v, w;
+        std::vector<std::vector<std::complex<double>>> visibilities;
+        std::vector<std::vector<double>> images;
+    };
+
+    struct Worker {
+        ImagingBackend* backend = nullptr;
+        std::map<std::pair<size_t, int>, Workspace> workspaces;
+    };
+
+    void handleLine(const std::string& line, Clock::time_point received, const Responder& respond);
+    void submitDirections(const std::shared_ptr<Request>& request, std::vector<double> HAs, std::vector<double> Decs);
+    void submitVisibilities(const std::shared_ptr<Request>& request, const std::string& filename);
+    void imageBatch(Request& request, size_t first, size_t count, unsigned worker);
+    void imageFile(Request& request, const std::string& filename, unsigned worker);
+    void finishTask(Request& request);
+    Workspace& workspace(unsigned worker, size_t num_directions, int image_size);
+    std::string statsResponse();
+    void requestShutdown();
+
+    int serveStream(std::istream& input);
+    int serveFifo(const std::string& path);
+    int serveUnixSocket(const std::string& path);
+    void respondStdout(const std::string& response);
+
+    ServeOptions options_;
+    const std::vector<double>& x_m_;
+    const std::vector<double>& y_m_;
+    const std::vector<double>& z_m_;
+
+    std::vector<std::unique_ptr<ImagingBackend>> backends_;
+    bool shared_backend_ = false;
+    std::mutex backend_mutex_;
+    std::vector<Worker> workers_;
+    // Destroyed first (see ~ImagingServer), so queued tasks finish while the workers and statistics exist
+    std::unique_ptr<WorkStealingPool> pool_;
+
+    std::mutex stats_mutex_;
+    LatencyStats latencies_;
+    size_t next_request_ = 0;
+    size_t failed_requests_ = 0;
+    size_t directions_imaged_ = 0;
+    std::atomic<size_t> workspace_buckets_{0};
+
+    std::mutex stdout_mutex_;
+    std::atomic<bool> stopping_{false};
+    int listen_fd_ = -1;
+};
+
+#endif
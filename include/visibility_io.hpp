@@ -0,0 +1,99 @@
+// include/visibility_io.hpp
+#ifndef VISIBILITY_IO_HPP
+#define VISIBILITY_IO_HPP
+
+#include <complex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Binary visibility file.
+ *
+ * Layout (host byte order, little-endian on supported platforms): the magic
+ * "RIVISBIN", uint32 version, uint32 record size, uint64 number of directions, one
+ * uint64 visibility count per direction, then the records of direction 0,
+ * direction 1, ... Every record is five doubles: u, v, w, real, imaginary.
+ */
+constexpr size_t VISIBILITY_RECORD_SIZE = 5 * sizeof(double);
+
+bool writeVisibilityFile(const std::string& filename,
+                         const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                         const std::vector<std::vector<double>>& w_batch,
+                         const std::vector<std::vector<std::complex<double>>>& visibilities_batch);
+
+/**
+ * @brief A block of visibilities of one direction, stored as separate u, v and visibility arrays.
+ */
+struct VisibilityBlock {
+    int direction = 0;
+    size_t count = 0;
+    std::vector<double> u;
+    std::vector<double> v;
+    std::vector<std::complex<double>> visibilities;
+};
+
+/**
+ * @brief Streams a visibility file in fixed-size blocks with double buffering.
+ *
+ * A reader thread fills one block while the consumer grids the other one: next()
+ * hands out the next filled block and returns the previous one to the reader. Blocks
+ * never span two directions. Only two blocks and one read buffer are resident, so
+ * the memory used does not depend on the size of the file.
+ */
+class VisibilityStream {
+public:
+    ~VisibilityStream();
+
+    bool open(const std::string& filename);
+    double maxU(int direction);
+    void start(size_t block_visibilities);
+    const VisibilityBlock* next();
+
+    int numDirections() const { return static_cast<int>(counts_.size()); }
+    size_t numVisibilities(int direction) const { return counts_[direction]; }
+    std::uint64_t totalVisibilities() const;
+    size_t blockVisibilities() const { return block_visibilities_; }
+    bool failed() const { return failed_; }
+    size_t blocksRead() const { return blocks_read_; }
+    double consumerWaitMilliseconds() const { return consumer_wait_ms_; }
+
+    /// Resident bytes per visibility of a block size: two blocks plus the read buffer.
+    static constexpr size_t bytesPerBufferedVisibility() {
+        return 2 * (2 * sizeof(double) + sizeof(std::complex<double>)) + VISIBILITY_RECORD_SIZE;
+    }
+
+private:
+    void run();
+    bool readBlock(VisibilityBlock& block, int direction, size_t first, size_t count);
+    void stop();
+
+    std::string filename_;
+    std::ifstream file_;
+    std::vector<std::uint64_t> counts_;
+    std::vector<std::uint64_t> offsets_;
+    size_t block_visibilities_ = 0;
+    std::vector<char> read_buffer_;
+
+    VisibilityBlock blocks_[2];
+    bool filled_[2] = {false, false};
+    int consumer_block_ = -1;
+    int next_block_ = 0;
+    bool finished_ = false;
+    bool stopping_ = false;
+    bool failed_ = false;
+    size_t blocks_read_ = 0;
+    double consumer_wait_ms_ = 0.0;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
+
+size_t streamBlockVisibilities(const VisibilityStream& stream, int image_size, size_t memory_budget_mb);
+
+#endif
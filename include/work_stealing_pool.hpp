@@ -0,0 +1,144 @@
+// include/work_stealing_pool.hpp
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed pool of worker threads with one task deque per worker and work stealing.
+ *
+ * submit() deals tasks round-robin onto the worker deques. A worker takes tasks from
+ * the front of its own deque and, when that is empty, steals from the back of the
+ * other deques, so a worker that drew cheap tasks helps the others instead of idling.
+ * Tasks receive the index of the worker that runs them, so they can use per-worker
+ * state (backends, workspaces) without locking.
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void(unsigned worker)>;
+
+    explicit WorkStealingPool(unsigned num_workers) : queues_(num_workers > 0 ? num_workers : 1) {
+        for (auto& queue : queues_) {
+            queue = std::make_unique<Queue>();
+        }
+        for (unsigned w = 0; w < queues_.size(); ++w) {
+            threads_.emplace_back([this, w]() { run(w); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues_.size()); }
+
+    /**
+     * @brief Queue a task on the next worker deque (round-robin).
+     */
+    void submit(Task task) {
+        Queue& queue = *queues_[next_queue_.fetch_add(1) % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++pending_;
+        }
+        wake_.notify_one();
+    }
+
+    /**
+     * @brief Wait until every submitted task has finished.
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return pending_ == 0; });
+    }
+
+    /**
+     * @brief Number of tasks a worker took from another worker's deque.
+     */
+    size_t steals() const { return steals_.load(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool popOwn(unsigned worker, Task& task) {
+        Queue& queue = *queues_[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(unsigned worker, Task& task) {
+        for (size_t k = 1; k < queues_.size(); ++k) {
+            Queue& queue = *queues_[(worker + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                steals_.fetch_add(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(unsigned worker) {
+        while (true) {
+            Task task;
+            if (popOwn(worker, task) || steal(worker, task)) {
+                task(worker);
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--pending_ == 0) {
+                    idle_.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopping_ && pending_ == 0) {
+                return;
+            }
+            // pending_ counts queued and running tasks; wake up when a new task arrives
+            size_t seen = pending_;
+            wake_.wait(lock, [this, seen]() { return stopping_ || pending_ > seen; });
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> steals_{0};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+};
+
+#endif
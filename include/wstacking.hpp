@@ -0,0 +1,130 @@
+// include/wstacking.hpp
+#ifndef WSTACKING_HPP
+#define WSTACKING_HPP
+
+#include "gridding.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Placement of the w-planes of one direction.
+ *
+ * Plane p holds the visibilities with w in [w_min + p * w_step, w_min + (p + 1) * w_step)
+ * and is corrected with the phase screen of its center.
+ */
+struct WStackLayout {
+    double w_min;
+    double w_step;
+    int num_planes;
+
+    double planeCenter(int plane) const { return w_min + (plane + 0.5) * w_step; }
+};
+
+/**
+ * @brief Report of one imaged w-plane (empty planes are skipped and not reported).
+ */
+struct WPlaneTiming {
+    int plane;
+    size_t num_visibilities;
+    double time_ms;
+};
+
+/// Largest phase error (radians) of the w term that the automatic plane count allows at the image corners.
+constexpr double W_STACK_MAX_PHASE_ERROR = 0.25;
+
+/**
+ * @brief n - 1 of image pixel (k, l), with n = sqrt(1 - l^2 - m^2).
+ *
+ * The direction cosines follow from the grid: the image spans 1 / grid_res radians
+ * and its center is pixel (image_size / 2, image_size / 2). Pixels outside the unit
+ * circle get -1.
+ *
+ * @param k Row of the pixel (l axis).
+ * @param l Column of the pixel (m axis).
+ * @param image_size Size of the image.
+ * @param grid_res Resolution of the uv grid.
+ * @return double n - 1 (non-positive).
+ */
+GRID_HOST_DEVICE inline double wTermNMinusOne(int k, int l, int image_size, double grid_res) {
+    double l_cos = (k - image_size / 2) / (image_size * grid_res);
+    double m_cos = (l - image_size / 2) / (image_size * grid_res);
+    double r2 = l_cos * l_cos + m_cos * m_cos;
+    if (r2 >= 1.0) {
+        return -1.0;
+    }
+    // Same as sqrt(1 - r2) - 1, without the cancellation for small fields
+    return -r2 / (1.0 + sqrt(1.0 - r2));
+}
+
+/**
+ * @brief W-plane of a visibility (clamped to the valid planes).
+ */
+GRID_HOST_DEVICE inline int wPlaneIndex(double w, double w_min, double w_step, int num_planes) {
+    int plane = static_cast<int>((w - w_min) / w_step);
+    return plane < 0 ? 0 : (plane >= num_planes ? num_planes - 1 : plane);
+}
+
+/**
+ * @brief Choose the w-planes of every direction.
+ *
+ * All directions use the same number of planes so that a plane can be gridded and
+ * transformed for all directions in one batch, but every direction spreads them over
+ * its own w range. With requested_planes == 0 the number of planes is picked from the
+ * w ranges and the field of view: a visibility is at most half a plane away from the
+ * plane center, so planes are spaced such that pi * w_step * max|n - 1| stays below
+ * W_STACK_MAX_PHASE_ERROR.
+ *
+ * @param w_batch W coordinates for multiple directions.
+ * @param image_size Size of the image.
+ * @param grid_res Resolution of the uv grid.
+ * @param requested_planes Number of planes, or 0 to choose automatically.
+ * @return std::vector<WStackLayout> One layout per direction.
+ */
+inline std::vector<WStackLayout> wStackLayouts(const std::vector<std::vector<double>>& w_batch, int image_size, double grid_res,
+                                               int requested_planes) {
+    const double max_n_minus_one = std::abs(wTermNMinusOne(0, 0, image_size, grid_res));
+
+    std::vector<WStackLayout> layouts(w_batch.size(), WStackLayout{0.0, 1.0, 1});
+    std::vector<double> w_ranges(w_batch.size(), 0.0);
+    int num_planes = std::max(requested_planes, 1);
+    for (size_t d = 0; d < w_batch.size(); ++d) {
+        if (w_batch[d].empty()) continue;
+        auto range = std::minmax_element(w_batch[d].begin(), w_batch[d].end());
+        layouts[d].w_min = *range.first;
+        w_ranges[d] = *range.second - *range.first;
+        if (requested_planes <= 0) {
+            int planes = static_cast<int>(std::ceil(M_PI * w_ranges[d] * max_n_minus_one / W_STACK_MAX_PHASE_ERROR));
+            num_planes = std::max(num_planes, planes);
+        }
+    }
+
+    for (size_t d = 0; d < w_batch.size(); ++d) {
+        layouts[d].num_planes = num_planes;
+        layouts[d].w_step = w_ranges[d] > 0.0 ? w_ranges[d] / num_planes : 1.0;
+    }
+    return layouts;
+}
+
+/**
+ * @brief n - 1 of every pixel, stored at the FFT output element that holds the pixel (see imageSourceIndex).
+ *
+ * Keeping the screen in the FFT output layout lets w-stacking accumulate the transformed
+ * planes without reordering them; the FFT engines extract the image afterwards.
+ *
+ * @param image_size Size of the image.
+ * @param grid_res Resolution of the uv grid.
+ * @return std::vector<double> image_size^2 values.
+ */
+inline std::vector<double> wTermScreen(int image_size, double grid_res) {
+    std::vector<double> screen(static_cast<size_t>(image_size) * image_size);
+    for (int k = 0; k < image_size; ++k) {
+        for (int l = 0; l < image_size; ++l) {
+            screen[imageSourceIndex(k, l, image_size)] = wTermNMinusOne(k, l, image_size, grid_res);
+        }
+    }
+    return screen;
+}
+
+#endif
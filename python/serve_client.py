@@ -0,0 +1,138 @@
+import argparse
+import csv
+import json
+import socket
+import subprocess
+import time
+
+
+def read_directions(filename):
+    """ Read the (HA, Dec) pairs of a directions CSV file with a header line. """
+    with open(filename, newline='') as f:
+        reader = csv.reader(f)
+        next(reader, None)
+        return [[float(row[0]), float(row[1])] for row in reader if len(row) >= 2]
+
+
+def build_requests(directions, num_requests, directions_per_request):
+    """ Build num_requests direction requests, cycling through the directions. """
+    requests = []
+    k = 0
+    for n in range(num_requests):
+        chunk = []
+        for _ in range(directions_per_request):
+            chunk.append(directions[k % len(directions)])
+            k += 1
+        requests.append({'id': f'req{n}', 'directions': chunk})
+    return requests
+
+
+class StdinConnection:
+    """ Starts RadioImager --serve stdin and talks to it through its stdin and stdout. """
+
+    def __init__(self, executable, server_args):
+        self.process = subprocess.Popen([executable, '--serve', 'stdin'] + server_args,
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+
+    def send(self, message):
+        self.process.stdin.write(json.dumps(message) + '\n')
+        self.process.stdin.flush()
+
+    def receive(self):
+        line = self.process.stdout.readline()
+        return json.loads(line) if line else None
+
+    def close(self):
+        self.process.stdin.close()
+        self.process.wait()
+
+
+class SocketConnection:
+    """ Connects to a running RadioImager --serve unix:<path>. """
+
+    def __init__(self, path):
+        self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.socket.connect(path)
+        self.reader = self.socket.makefile('r')
+
+    def send(self, message):
+        self.socket.sendall((json.dumps(message) + '\n').encode())
+
+    def receive(self):
+        line = self.reader.readline()
+        return json.loads(line) if line else None
+
+    def close(self):
+        self.reader.close()
+        self.socket.close()
+
+
+def percentile(values, p):
+    """ Nearest-rank percentile (the same definition as the server). """
+    ordered = sorted(values)
+    rank = max(1, -(-len(ordered) * p // 100))
+    return ordered[min(len(ordered), int(rank)) - 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send direction requests to RadioImager --serve and report the latencies.")
+    parser.add_argument('--socket', type=str, default='', help='Unix socket of a running server (default: start ./build/RadioImager --serve stdin).')
+    parser.add_argument('--executable', type=str, default='./build/RadioImager', help='RadioImager executable started when --socket is not given.')
+    parser.add_argument('--server_args', type=str, default='', help='Extra arguments of the started server, e.g. "--backend cpu --input data/xyz_coordinates.csv".')
+    parser.add_argument('--directions', type=str, default='data/directions.csv', help='Path to the directions CSV file with HAs and Decs.')
+    parser.add_argument('--requests', type=int, default=20, help='Number of requests to send.')
+    parser.add_argument('--directions_per_request', type=int, default=4, help='Number of directions per request.')
+    parser.add_argument('--shutdown', action='store_true', help='Send the shutdown command at the end (always done for a started server).')
+    args = parser.parse_args()
+
+    directions = read_directions(args.directions)
+    if not directions:
+        raise SystemExit(f'No directions in {args.directions}')
+    requests = build_requests(directions, args.requests, args.directions_per_request)
+
+    if args.socket:
+        connection = SocketConnection(args.socket)
+    else:
+        connection = StdinConnection(args.executable, args.server_args.split())
+
+    # All requests are sent at once so that the server images them concurrently
+    start = time.perf_counter()
+    for request in requests:
+        connection.send(request)
+
+    latencies = []
+    failed = 0
+    for _ in requests:
+        response = connection.receive()
+        if response is None:
+            raise SystemExit('Server closed the connection')
+        if response.get('status') == 'ok':
+            latencies.append(response['latency_ms'])
+            print(f"{response['id']}: {response['directions']} directions in {response['latency_ms']:.1f} ms"
+                  + (f" -> {response['images']}" if 'images' in response else ''))
+        else:
+            failed += 1
+            print(f"{response.get('id')}: error: {response.get('error')}")
+    elapsed = time.perf_counter() - start
+
+    connection.send({'command': 'stats'})
+    stats = connection.receive()
+    if args.shutdown or not args.socket:
+        connection.send({'command': 'shutdown'})
+        connection.receive()
+    connection.close()
+
+    print(f'{len(requests)} requests ({failed} failed) in {elapsed:.2f} s, '
+          f'{len(requests) * args.directions_per_request / elapsed:.1f} directions/s')
+    if latencies:
+        print(f'Request latency p50: {percentile(latencies, 50):.1f} ms, '
+              f'p95: {percentile(latencies, 95):.1f} ms, p99: {percentile(latencies, 99):.1f} ms')
+    print(f"Server: {stats['requests']} requests, p50: {stats['latency_p50_ms']:.1f} ms, "
+          f"p95: {stats['latency_p95_ms']:.1f} ms, p99: {stats['latency_p99_ms']:.1f} ms, "
+          f"{stats['steals']} stolen tasks, {stats['workspace_buckets']} workspace buckets")
+    if failed:
+        raise SystemExit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,18 @@
+#include "backend.hpp"
+
+/**
+ * @brief Create the imaging backend selected by name.
+ * 
+ * @param name Backend name, either "cuda" or "cpu".
+ * @param num_threads Number of worker threads for the CPU backend (0 = all hardware threads).
+ * @return std::unique_ptr<ImagingBackend> The backend, or nullptr if the name is unknown.
+ */
+std::unique_ptr<ImagingBackend> makeBackend(const std::string& name, unsigned num_threads) {
+    if (name == "cuda") {
+        return makeCudaBackend();
+    }
+    if (name == "cpu") {
+        return makeCpuBackend(num_threads);
+    }
+    return nullptr;
+}
@@ -1,11 +1,17 @@
 #include "config.hpp"
 #include "compute.hpp"
+#include "backend.hpp"
+#include "visibility_io.hpp"
 #include <cufft.h>
 #include <thrust/complex.h>
 #include <thrust/device_vector.h>
+#include <thrust/sort.h>
+#include <thrust/binary_search.h>
+#include <thrust/iterator/counting_iterator.h>
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <chrono>
 #include <cuda_runtime.h>
 
 /**
@@ -84,69 +90,11 @@ __device__ double atomicAdd(double* address, double val) {
 #endif
 
 
-/**
- * @brief Perform a 2D FFT shift operation on the given data.
- * 
- * @param data Input data to be shifted.
- * @param temp Temporary data storage for shifting.
- * @param width Width of the data array.
- * @param height Height of the data array.
- * @param shiftX Amount to shift in the X direction.
- * @param shiftY Amount to shift in the Y direction.
- */
-__global__ void fftshift_kernel(cufftDoubleComplex* data, cufftDoubleComplex* temp, int width, int height, int shiftX, int shiftY) {
-    extern __shared__ cufftDoubleComplex shared_data[];
-    
-    int x = blockIdx.x * blockDim.x + threadIdx.x;
-    int y = blockIdx.y * blockDim.y + threadIdx.y;
-    int tid = threadIdx.y * blockDim.x + threadIdx.x;
-
-    if (x < width && y < height) {
-        shared_data[tid] = data[y * width + x];
-    }
-    __syncthreads();
-
-    if (x < width && y < height) {
-        int new_i = (y + shiftY) % height;
-        int new_j = (x + shiftX) % width;
-        temp[new_i * width + new_j] = shared_data[tid];
-    }
-}
-
-/**
- * @brief Perform a 2D FFT shift on a thrust::device_vector.
- * 
- * @param data Data to be shifted.
- * @param width Width of the data array.
- * @param height Height of the data array.
- */
-void fftshift(thrust::device_vector<cufftDoubleComplex>& data, int width, int height) {
-    thrust::device_vector<cufftDoubleComplex> temp(data.size());
-
-    dim3 threadsPerBlock(16, 16);
-    dim3 blocksPerGrid((width + threadsPerBlock.x - 1) / threadsPerBlock.x,
-                       (height + threadsPerBlock.y - 1) / threadsPerBlock.y);
-
-    int shiftX = width / 2;
-    int shiftY = height / 2;
-    size_t sharedMemSize = threadsPerBlock.x * threadsPerBlock.y * sizeof(cufftDoubleComplex);
-
-    cudaStream_t stream;
-    cudaStreamCreate(&stream);
-
-    fftshift_kernel<<<blocksPerGrid, threadsPerBlock, sharedMemSize, stream>>>(thrust::raw_pointer_cast(data.data()),
-                                                        thrust::raw_pointer_cast(temp.data()),
-                                                        width, height, shiftX, shiftY);
-
-    cudaStreamSynchronize(stream);
-    cudaStreamDestroy(stream);
-    data = temp;
-}
-
-
 /**
  * @brief Map visibilities to a grid for multiple directions (batches).
  * 
+ * The grid is written in FFT-engine layout (see gridStorageIndex).
+ * 
  * @param grid Output grid to store the mapped visibilities.
  * @param visibilities Input visibilities to map.
  * @param u U coordinates of visibilities.
@@ -157,11 +105,17 @@ void fftshift(thrust::device_vector<cufftDoubleComplex>& data, int width, int he
  * @param num_visibilities Number of visibilities.
  * @param num_directions Number of directions.
  */
-__global__ void mapVisibilitiesMultiDir(cufftDoubleComplex* grid, const cufftDoubleComplex* visibilities, const double* u, const double* v, double uv_max, double grid_res, int image_size, int num_visibilities, int num_directions) {
-    extern __shared__ double shared_mem[];
-    double* shared_u = shared_mem;
-    double* shared_v = shared_u + blockDim.x;
-    cufftDoubleComplex* shared_vis = (cufftDoubleComplex*)(shared_v + blockDim.x);
+template <typename UVWReal, typename GridReal>
+__global__ void mapVisibilitiesMultiDir(typename CufftTypes<GridReal>::Complex* grid, const typename CufftTypes<GridReal>::Complex* visibilities,
+                                        const UVWReal* u, const UVWReal* v, UVWReal uv_max, UVWReal grid_res,
+                                        int image_size, int num_visibilities, int num_directions) {
+    using Complex = typename CufftTypes<GridReal>::Complex;
+
+    // Raw bytes, because every instantiation shares the same extern shared array
+    extern __shared__ __align__(16) unsigned char shared_mem[];
+    Complex* shared_vis = reinterpret_cast<Complex*>(shared_mem);
+    UVWReal* shared_u = reinterpret_cast<UVWReal*>(shared_vis + blockDim.x);
+    UVWReal* shared_v = shared_u + blockDim.x;
 
     int idx = blockIdx.x * blockDim.x + threadIdx.x;
     int dir_idx = blockIdx.y;
@@ -177,7 +131,7 @@ __global__ void mapVisibilitiesMultiDir(cufftDoubleComplex* grid, const cufftDou
 
     if (idx < num_visibilities) {
         // Skip adding visibility if both u and v are zero
-        if (shared_u[threadIdx.x] == 0.0 && shared_v[threadIdx.x] == 0.0) {
+        if (shared_u[threadIdx.x] == UVWReal(0) && shared_v[threadIdx.x] == UVWReal(0)) {
             return;
         }
 
@@ -187,60 +141,121 @@ __global__ void mapVisibilitiesMultiDir(cufftDoubleComplex* grid, const cufftDou
         j_index = (j_index + image_size) % image_size;
 
         if (i_index < image_size && j_index < image_size) {
-            atomicAdd(&grid[dir_idx * image_size * image_size + i_index * image_size + j_index].x, shared_vis[threadIdx.x].x);
-            atomicAdd(&grid[dir_idx * image_size * image_size + i_index * image_size + j_index].y, shared_vis[threadIdx.x].y);
+            int cell = dir_idx * image_size * image_size + gridStorageIndex(i_index, j_index, image_size);
+            GridReal sign = static_cast<GridReal>(gridStorageSign(i_index, j_index, image_size));
+            atomicAdd(&grid[cell].x, sign * shared_vis[threadIdx.x].x);
+            atomicAdd(&grid[cell].y, sign * shared_vis[threadIdx.x].y);
         }
     }
 }
 
 /**
- * @brief Generate a uniform image from visibilities using FFT.
+ * @brief Compute the tile-major sort key of every visibility for the tiled gridder.
  * 
- * @param visibilities_batch Batch of visibilities for multiple directions.
- * @param u_batch U coordinates for multiple directions.
- * @param v_batch V coordinates for multiple directions.
+ * Keys enumerate cells tile by tile (and direction by direction), so after sorting
+ * all visibilities of a tile are contiguous. Visibilities that are not gridded
+ * (zero baselines, out-of-range cells) get a sentinel key that sorts last.
+ * 
+ * @param u U coordinates of visibilities.
+ * @param v V coordinates of visibilities.
+ * @param uv_max Maximum UV coordinate value.
+ * @param grid_res Resolution of the grid.
  * @param image_size Size of the output image.
- * @param images Output images.
- * @param use_predefined_params Flag to determine if predefined parameters should be used.
+ * @param tiles_per_row Number of tiles along one grid axis.
+ * @param num_visibilities Number of visibilities per direction.
+ * @param num_directions Number of directions.
+ * @param keys Output sort keys.
+ * @param vis_ids Output visibility indices (identity permutation).
  */
-void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
-                  const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
-                  int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params) {
-    int num_batches = visibilities_batch.size();
-    images.resize(num_batches);
+template <typename UVWReal>
+__global__ void computeTileKeys(const UVWReal* u, const UVWReal* v, UVWReal uv_max, UVWReal grid_res, int image_size, int tiles_per_row,
+                                int num_visibilities, int num_directions, long long* keys, int* vis_ids) {
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    int dir_idx = blockIdx.y;
 
-    cudaStream_t stream;
-    cudaStreamCreate(&stream);
+    if (dir_idx >= num_directions || idx >= num_visibilities) return;
 
-    cufftDoubleComplex* d_visibility_grid;
-    size_t memSize = num_batches * image_size * image_size * sizeof(cufftDoubleComplex);
-    CHECK_CUDA(cudaMalloc((void**)&d_visibility_grid, memSize));
-    CHECK_CUDA(cudaMemset(d_visibility_grid, 0, memSize)); // Initialize memory to zero
+    const long long tile_cells = GRID_TILE_SIZE * GRID_TILE_SIZE;
+    const long long cells_per_dir = static_cast<long long>(tiles_per_row) * tiles_per_row * tile_cells;
+    int in = dir_idx * num_visibilities + idx;
+    long long key = cells_per_dir * num_directions;
 
-    thrust::device_vector<double> d_u(num_batches * u_batch[0].size());
-    thrust::device_vector<double> d_v(num_batches * v_batch[0].size());
+    if (!(u[in] == UVWReal(0) && v[in] == UVWReal(0))) {
+        int i_index = static_cast<int>((u[in] + uv_max) / grid_res);
+        int j_index = static_cast<int>((v[in] + uv_max) / grid_res);
+        i_index = (i_index + image_size) % image_size;
+        j_index = (j_index + image_size) % image_size;
 
-    for (int b = 0; b < num_batches; ++b) {
-        CHECK_CUDA(cudaMemcpyAsync(thrust::raw_pointer_cast(d_u.data()) + b * u_batch[0].size(), 
-                                   u_batch[b].data(), 
-                                   u_batch[b].size() * sizeof(double), 
-                                   cudaMemcpyHostToDevice, 
-                                   stream));
-        CHECK_CUDA(cudaMemcpyAsync(thrust::raw_pointer_cast(d_v.data()) + b * v_batch[0].size(), 
-                                   v_batch[b].data(), 
-                                   v_batch[b].size() * sizeof(double), 
-                                   cudaMemcpyHostToDevice, 
-                                   stream));
+        if (i_index >= 0 && j_index >= 0 && i_index < image_size && j_index < image_size) {
+            int tile = (i_index / GRID_TILE_SIZE) * tiles_per_row + j_index / GRID_TILE_SIZE;
+            int local = (i_index % GRID_TILE_SIZE) * GRID_TILE_SIZE + j_index % GRID_TILE_SIZE;
+            key = dir_idx * cells_per_dir + tile * tile_cells + local;
+        }
     }
 
-    double max_uv = use_predefined_params ? config::PREDEFINED_MAX_UV : *std::max_element(u_batch[0].begin(), u_batch[0].end());
-    double pixel_resolution = (0.20 / max_uv) / 3;
-    double uv_resolution = 1 / (image_size * pixel_resolution);
-    double uv_max = uv_resolution * image_size / 2;
-    double grid_res = 2 * uv_max / image_size;
+    keys[in] = key;
+    vis_ids[in] = in;
+}
 
+/**
+ * @brief Accumulate binned visibilities tile by tile without atomics.
+ * 
+ * One block handles one GRID_TILE_SIZE x GRID_TILE_SIZE tile of one direction and
+ * each thread owns one cell. The thread sums the contiguous run of sorted
+ * visibilities that fall in its cell in registers and writes the cell exactly once.
+ * 
+ * @param grid Output grid in FFT-engine layout (every cell is written).
+ * @param visibilities Input visibilities.
+ * @param vis_ids Visibility indices sorted by tile-major key.
+ * @param offsets Start of every key's run in vis_ids (one entry per key plus one).
+ * @param image_size Size of the output image.
+ * @param tiles_per_row Number of tiles along one grid axis.
+ */
+template <typename Real>
+__global__ void accumulateTiles(typename CufftTypes<Real>::Complex* grid, const typename CufftTypes<Real>::Complex* visibilities,
+                                const int* vis_ids, const int* offsets, int image_size, int tiles_per_row) {
+    int tile = blockIdx.x;
+    int dir_idx = blockIdx.y;
+
+    const long long tile_cells = GRID_TILE_SIZE * GRID_TILE_SIZE;
+    const long long cells_per_dir = static_cast<long long>(tiles_per_row) * tiles_per_row * tile_cells;
+    long long key = dir_idx * cells_per_dir + tile * tile_cells + threadIdx.y * GRID_TILE_SIZE + threadIdx.x;
+
+    Real sum_x = 0;
+    Real sum_y = 0;
+    for (int k = offsets[key]; k < offsets[key + 1]; ++k) {
+        typename CufftTypes<Real>::Complex vis = visibilities[vis_ids[k]];
+        sum_x += vis.x;
+        sum_y += vis.y;
+    }
+
+    int i_index = (tile / tiles_per_row) * GRID_TILE_SIZE + threadIdx.y;
+    int j_index = (tile % tiles_per_row) * GRID_TILE_SIZE + threadIdx.x;
+    if (i_index < image_size && j_index < image_size) {
+        Real sign = static_cast<Real>(gridStorageSign(i_index, j_index, image_size));
+        grid[static_cast<size_t>(dir_idx) * image_size * image_size + gridStorageIndex(i_index, j_index, image_size)] = {sign * sum_x, sign * sum_y};
+    }
+}
+
+/**
+ * @brief Grid all directions with the atomic scatter kernel, in chunks of visibilities.
+ * 
+ * @param d_visibility_grid Zero-initialized output grids for all directions.
+ * @param visibilities_batch Batch of visibilities for multiple directions.
+ * @param d_u U coordinates of all directions on the device.
+ * @param d_v V coordinates of all directions on the device.
+ * @param uv_max Maximum UV coordinate value.
+ * @param grid_res Resolution of the grid.
+ * @param image_size Size of the output image.
+ */
+template <typename UVWReal, typename GridReal>
+static void gridScatter(typename CufftTypes<GridReal>::Complex* d_visibility_grid, const std::vector<std::vector<std::complex<GridReal>>>& visibilities_batch,
+                        const UVWReal* d_u, const UVWReal* d_v,
+                        double uv_max, double grid_res, int image_size) {
+    using Complex = typename CufftTypes<GridReal>::Complex;
+    int num_batches = visibilities_batch.size();
     int threadsPerBlock = 1024;
-    size_t sharedMemSize = threadsPerBlock * (sizeof(double) * 2 + sizeof(cufftDoubleComplex));
+    size_t sharedMemSize = threadsPerBlock * (sizeof(UVWReal) * 2 + sizeof(Complex));
     size_t chunk_size = 1000000; // Adjust this chunk size based on experimentation
     size_t num_chunks = (visibilities_batch[0].size() + chunk_size - 1) / chunk_size;
 
@@ -253,22 +268,21 @@ void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibili
         size_t start = chunk * chunk_size;
         size_t end = std::min(start + chunk_size, visibilities_batch[0].size());
 
-        std::vector<cufftDoubleComplex> vis_chunk_cufft;
+        // std::complex and the cuFFT complex types have the same layout, so every direction's
+        // slice of the chunk is copied straight into place without repacking
+        thrust::device_vector<Complex> d_vis_chunk(num_batches * (end - start));
         for (int b = 0; b < num_batches; ++b) {
-            for (size_t i = start; i < end; ++i) {
-                vis_chunk_cufft.push_back(make_cuDoubleComplex(visibilities_batch[b][i].real(), visibilities_batch[b][i].imag()));
-            }
+            CHECK_CUDA(cudaMemcpy(thrust::raw_pointer_cast(d_vis_chunk.data()) + b * (end - start),
+                                  visibilities_batch[b].data() + start, (end - start) * sizeof(Complex), cudaMemcpyHostToDevice));
         }
 
-        thrust::device_vector<cufftDoubleComplex> d_vis_chunk = vis_chunk_cufft;
-
         dim3 blocksPerGrid((end - start + threadsPerBlock - 1) / threadsPerBlock, num_batches);
-        mapVisibilitiesMultiDir<<<blocksPerGrid, threadsPerBlock, sharedMemSize, streams[chunk]>>>(
+        mapVisibilitiesMultiDir<UVWReal, GridReal><<<blocksPerGrid, threadsPerBlock, sharedMemSize, streams[chunk]>>>(
             d_visibility_grid,
             thrust::raw_pointer_cast(d_vis_chunk.data()),
-            thrust::raw_pointer_cast(d_u.data()),
-            thrust::raw_pointer_cast(d_v.data()),
-            uv_max, grid_res, image_size, end - start, num_batches);
+            d_u,
+            d_v,
+            static_cast<UVWReal>(uv_max), static_cast<UVWReal>(grid_res), image_size, end - start, num_batches);
 
         CHECK_CUDA(cudaGetLastError());
     }
@@ -277,79 +291,853 @@ void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibili
         CHECK_CUDA(cudaStreamSynchronize(streams[i]));
         cudaStreamDestroy(streams[i]);
     }
+}
 
-    cudaStream_t stream2;
-    cudaStreamCreate(&stream2);
+/**
+ * @brief Grid all directions with the atomic-free tiled gridder.
+ * 
+ * Visibilities are binned by uv tile with a device sort on tile-major cell keys,
+ * the run boundaries of every cell are found with a vectorized binary search, and
+ * accumulateTiles then sums each tile in one pass.
+ * 
+ * @param d_visibility_grid Output grids for all directions.
+ * @param visibilities_batch Batch of visibilities for multiple directions.
+ * @param d_u U coordinates of all directions on the device.
+ * @param d_v V coordinates of all directions on the device.
+ * @param uv_max Maximum UV coordinate value.
+ * @param grid_res Resolution of the grid.
+ * @param image_size Size of the output image.
+ */
+template <typename UVWReal, typename GridReal>
+static void gridTiled(typename CufftTypes<GridReal>::Complex* d_visibility_grid, const std::vector<std::vector<std::complex<GridReal>>>& visibilities_batch,
+                      const UVWReal* d_u, const UVWReal* d_v,
+                      double uv_max, double grid_res, int image_size) {
+    using Complex = typename CufftTypes<GridReal>::Complex;
+    int num_batches = visibilities_batch.size();
+    int num_visibilities = visibilities_batch[0].size();
+    size_t total = static_cast<size_t>(num_batches) * num_visibilities;
+    int tiles_per_row = (image_size + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+    int num_tiles = tiles_per_row * tiles_per_row;
+    long long num_keys = static_cast<long long>(num_batches) * num_tiles * GRID_TILE_SIZE * GRID_TILE_SIZE;
 
+    std::vector<Complex> h_vis(total);
     for (int b = 0; b < num_batches; ++b) {
-        thrust::device_vector<cufftDoubleComplex> d_visibility_grid_batch(d_visibility_grid + b * image_size * image_size, d_visibility_grid + (b + 1) * image_size * image_size);
+        for (int i = 0; i < num_visibilities; ++i) {
+            h_vis[static_cast<size_t>(b) * num_visibilities + i] = {visibilities_batch[b][i].real(), visibilities_batch[b][i].imag()};
+        }
+    }
+    thrust::device_vector<Complex> d_vis = h_vis;
+
+    thrust::device_vector<long long> d_keys(total);
+    thrust::device_vector<int> d_vis_ids(total);
+
+    int threadsPerBlock = 256;
+    dim3 blocksPerGrid((num_visibilities + threadsPerBlock - 1) / threadsPerBlock, num_batches);
+    computeTileKeys<<<blocksPerGrid, threadsPerBlock>>>(d_u,
+                                                        d_v,
+                                                        static_cast<UVWReal>(uv_max), static_cast<UVWReal>(grid_res), image_size, tiles_per_row,
+                                                        num_visibilities, num_batches,
+                                                        thrust::raw_pointer_cast(d_keys.data()),
+                                                        thrust::raw_pointer_cast(d_vis_ids.data()));
+    CHECK_CUDA(cudaGetLastError());
+
+    thrust::sort_by_key(d_keys.begin(), d_keys.end(), d_vis_ids.begin());
 
-        fftshift(d_visibility_grid_batch, image_size, image_size);
+    thrust::device_vector<int> d_offsets(num_keys + 1);
+    thrust::lower_bound(d_keys.begin(), d_keys.end(),
+                        thrust::counting_iterator<long long>(0),
+                        thrust::counting_iterator<long long>(num_keys + 1),
+                        d_offsets.begin());
 
-        cufftHandle plan;
-        CHECK_CUFFT(cufftPlan2d(&plan, image_size, image_size, CUFFT_Z2Z));
-        cufftSetStream(plan, stream2);
-        CHECK_CUFFT(cufftExecZ2Z(plan, thrust::raw_pointer_cast(d_visibility_grid_batch.data()), thrust::raw_pointer_cast(d_visibility_grid_batch.data()), CUFFT_INVERSE));
-        CHECK_CUFFT(cufftDestroy(plan));
+    dim3 tileThreads(GRID_TILE_SIZE, GRID_TILE_SIZE);
+    dim3 tileBlocks(num_tiles, num_batches);
+    accumulateTiles<GridReal><<<tileBlocks, tileThreads>>>(d_visibility_grid,
+                                                           thrust::raw_pointer_cast(d_vis.data()),
+                                                           thrust::raw_pointer_cast(d_vis_ids.data()),
+                                                           thrust::raw_pointer_cast(d_offsets.data()),
+                                                           image_size, tiles_per_row);
+    CHECK_CUDA(cudaGetLastError());
+    CHECK_CUDA(cudaDeviceSynchronize());
+}
 
-        fftshift(d_visibility_grid_batch, image_size, image_size);
+/**
+ * @brief Extract the real images from the inverse-transformed grids and compute partial maxima.
+ * 
+ * The final fftshift is folded into the read index (see imageSourceIndex), so no
+ * shift pass or temporary grid is needed. Each block writes the maximum absolute
+ * value it saw to partial_max.
+ * 
+ * @param grids Inverse-transformed grids of all directions.
+ * @param images Output real images of all directions.
+ * @param partial_max Output per-block maxima, gridDim.x entries per direction.
+ * @param image_size Size of the images.
+ */
+template <typename Real>
+__global__ void extractImagesAndMax(const typename CufftTypes<Real>::Complex* grids, Real* images, Real* partial_max, int image_size) {
+    // Raw bytes, because every instantiation shares the same extern shared array
+    extern __shared__ __align__(16) unsigned char shared_bytes[];
+    Real* shared_max = reinterpret_cast<Real*>(shared_bytes);
 
-        thrust::host_vector<cufftDoubleComplex> h_output_grid = d_visibility_grid_batch;
+    int dir_idx = blockIdx.y;
+    int num_pixels = image_size * image_size;
+    const typename CufftTypes<Real>::Complex* grid = grids + static_cast<size_t>(dir_idx) * num_pixels;
+    Real* image = images + static_cast<size_t>(dir_idx) * num_pixels;
 
-        double max_value = 0.0;
-        for (size_t i = 0; i < h_output_grid.size(); ++i) {
-            if (abs(h_output_grid[i].x) > max_value) {
-                max_value = abs(h_output_grid[i].x);
-            }
+    Real local_max = 0;
+    for (int p = blockIdx.x * blockDim.x + threadIdx.x; p < num_pixels; p += gridDim.x * blockDim.x) {
+        int k = p / image_size;
+        int l = p % image_size;
+        Real value = static_cast<Real>(imageSourceSign(k, l, image_size)) * grid[imageSourceIndex(k, l, image_size)].x;
+        image[p] = value;
+        local_max = fmax(local_max, fabs(value));
+    }
+
+    shared_max[threadIdx.x] = local_max;
+    __syncthreads();
+    for (int stride = blockDim.x / 2; stride > 0; stride >>= 1) {
+        if (threadIdx.x < stride) {
+            shared_max[threadIdx.x] = fmax(shared_max[threadIdx.x], shared_max[threadIdx.x + stride]);
         }
+        __syncthreads();
+    }
 
-        images[b].resize(image_size * image_size);
-        for (size_t i = 0; i < images[b].size(); ++i) {
-            images[b][i] = h_output_grid[i].x / max_value;
+    if (threadIdx.x == 0) {
+        partial_max[dir_idx * gridDim.x + blockIdx.x] = shared_max[0];
+    }
+}
+
+/**
+ * @brief Normalize every image by its maximum absolute value.
+ * 
+ * @param images Real images of all directions (normalized in place).
+ * @param partial_max Per-block maxima from extractImagesAndMax.
+ * @param num_partials Number of partial maxima per direction.
+ * @param image_size Size of the images.
+ */
+template <typename Real>
+__global__ void normalizeImages(Real* images, const Real* partial_max, int num_partials, int image_size) {
+    __shared__ Real max_value;
+
+    int dir_idx = blockIdx.y;
+    if (threadIdx.x == 0) {
+        Real value = 0;
+        for (int i = 0; i < num_partials; ++i) {
+            value = fmax(value, partial_max[dir_idx * num_partials + i]);
         }
+        max_value = value;
+    }
+    __syncthreads();
+
+    int num_pixels = image_size * image_size;
+    Real* image = images + static_cast<size_t>(dir_idx) * num_pixels;
+    for (int p = blockIdx.x * blockDim.x + threadIdx.x; p < num_pixels; p += gridDim.x * blockDim.x) {
+        image[p] /= max_value;
+    }
+}
+
+/**
+ * @brief Unnormalized in-place inverse transform of a batch of single precision grids.
+ */
+static cufftResult execInverse(cufftHandle plan, cufftComplex* d_grids) {
+    return cufftExecC2C(plan, d_grids, d_grids, CUFFT_INVERSE);
+}
+
+/**
+ * @brief Unnormalized in-place inverse transform of a batch of double precision grids.
+ */
+static cufftResult execInverse(cufftHandle plan, cufftDoubleComplex* d_grids) {
+    return cufftExecZ2Z(plan, d_grids, d_grids, CUFFT_INVERSE);
+}
+
+template <typename Real>
+CudaFFTEngine<Real>::~CudaFFTEngine() {
+    release();
+}
+
+/**
+ * @brief Destroy all cached plans and free the device workspaces.
+ */
+template <typename Real>
+void CudaFFTEngine<Real>::release() {
+    for (auto& entry : plans_) {
+        cufftDestroy(entry.second);
     }
+    plans_.clear();
+
+    cudaFree(d_images_);
+    cudaFree(d_partial_max_);
+    d_images_ = nullptr;
+    d_partial_max_ = nullptr;
+    images_capacity_ = 0;
+    partial_max_capacity_ = 0;
+}
+
+/**
+ * @brief Get the cached batched plan for an image size and number of directions, creating it on first use.
+ * 
+ * @param image_size Size of the images.
+ * @param num_directions Number of directions in the batch.
+ * @return cufftHandle The cached plan.
+ */
+template <typename Real>
+cufftHandle CudaFFTEngine<Real>::planFor(int image_size, int num_directions) {
+    auto key = std::make_pair(image_size, num_directions);
+    auto it = plans_.find(key);
+    if (it != plans_.end()) {
+        return it->second;
+    }
+
+    cufftHandle plan;
+    int n[2] = {image_size, image_size};
+    int dist = image_size * image_size;
+    CHECK_CUFFT(cufftPlanMany(&plan, 2, n, nullptr, 1, dist, nullptr, 1, dist, CufftTypes<Real>::C2C, num_directions));
+    plans_[key] = plan;
+    return plan;
+}
+
+/**
+ * @brief Unnormalized in-place inverse 2D FFT of all directions with one batched plan.
+ * 
+ * @param d_grids Grids of all directions on the device, one image_size^2 block per direction.
+ * @param num_directions Number of directions.
+ * @param image_size Size of the images.
+ */
+template <typename Real>
+void CudaFFTEngine<Real>::inverse(Complex* d_grids, int num_directions, int image_size) {
+    CHECK_CUFFT(execInverse(planFor(image_size, num_directions), d_grids));
+}
+
+/**
+ * @brief Turn gridded visibilities into normalized real images.
+ * 
+ * Runs the batched inverse FFT, then extracts, max-reduces and normalizes the real
+ * images on the device (see extractImages).
+ * 
+ * @param d_grids Gridded visibilities of all directions in FFT-engine layout (transformed in place).
+ * @param num_directions Number of directions.
+ * @param image_size Size of the images.
+ * @param images Output images.
+ */
+template <typename Real>
+void CudaFFTEngine<Real>::toImages(Complex* d_grids, int num_directions, int image_size, std::vector<std::vector<Real>>& images) {
+    images.resize(num_directions);
+    if (num_directions == 0) return;
+
+    inverse(d_grids, num_directions, image_size);
+    extractImages(d_grids, num_directions, image_size, images);
+}
+
+/**
+ * @brief Extract, max-reduce and normalize the real images of inverse-transformed grids on the device.
+ * 
+ * Only the real images are copied back to the host.
+ * 
+ * @param d_grids Inverse-transformed grids of all directions on the device.
+ * @param num_directions Number of directions.
+ * @param image_size Size of the images.
+ * @param images Output images.
+ */
+template <typename Real>
+void CudaFFTEngine<Real>::extractImages(const Complex* d_grids, int num_directions, int image_size, std::vector<std::vector<Real>>& images) {
+    images.resize(num_directions);
+    if (num_directions == 0) return;
+
+    const size_t num_pixels = static_cast<size_t>(image_size) * image_size;
+    const int threadsPerBlock = 256;
+    const int num_partials = static_cast<int>(std::min<size_t>(64, (num_pixels + threadsPerBlock - 1) / threadsPerBlock));
+
+    if (images_capacity_ < num_directions * num_pixels) {
+        cudaFree(d_images_);
+        CHECK_CUDA(cudaMalloc((void**)&d_images_, num_directions * num_pixels * sizeof(Real)));
+        images_capacity_ = num_directions * num_pixels;
+    }
+    if (partial_max_capacity_ < static_cast<size_t>(num_directions) * num_partials) {
+        cudaFree(d_partial_max_);
+        CHECK_CUDA(cudaMalloc((void**)&d_partial_max_, static_cast<size_t>(num_directions) * num_partials * sizeof(Real)));
+        partial_max_capacity_ = static_cast<size_t>(num_directions) * num_partials;
+    }
+
+    dim3 blocksPerGrid(num_partials, num_directions);
+    extractImagesAndMax<Real><<<blocksPerGrid, threadsPerBlock, threadsPerBlock * sizeof(Real)>>>(d_grids, d_images_, d_partial_max_, image_size);
+    CHECK_CUDA(cudaGetLastError());
+    normalizeImages<Real><<<blocksPerGrid, threadsPerBlock>>>(d_images_, d_partial_max_, num_partials, image_size);
+    CHECK_CUDA(cudaGetLastError());
+
+    for (int b = 0; b < num_directions; ++b) {
+        images[b].resize(num_pixels);
+        CHECK_CUDA(cudaMemcpy(images[b].data(), d_images_ + b * num_pixels, num_pixels * sizeof(Real), cudaMemcpyDeviceToHost));
+    }
+}
+
+template class CudaFFTEngine<float>;
+template class CudaFFTEngine<double>;
+
+/**
+ * @brief Process-wide CUDA FFT engine of a precision, shared so that plans and workspaces are reused across calls.
+ * 
+ * @return CudaFFTEngine<Real>& The engine.
+ */
+template <typename Real>
+CudaFFTEngine<Real>& cudaFFTEngine() {
+    static CudaFFTEngine<Real> engine;
+    return engine;
+}
+
+template CudaFFTEngine<float>& cudaFFTEngine<float>();
+template CudaFFTEngine<double>& cudaFFTEngine<double>();
+
+CudaWorkspace::~CudaWorkspace() {
+    release();
+}
+
+/**
+ * @brief Device buffer of a slot with room for at least bytes, reallocated only when it must grow.
+ * 
+ * @param slot Buffer slot.
+ * @param bytes Required size in bytes.
+ * @return void* The device buffer (its contents are not preserved when it grows).
+ */
+void* CudaWorkspace::buffer(Slot slot, size_t bytes) {
+    if (bytes > capacities_[slot]) {
+        size_t capacity = 1;
+        while (capacity < bytes) capacity <<= 1;
+        if (buffers_[slot]) {
+            cudaFree(buffers_[slot]);
+        }
+        CHECK_CUDA(cudaMalloc(&buffers_[slot], capacity));
+        capacities_[slot] = capacity;
+    }
+    return buffers_[slot];
+}
+
+/**
+ * @brief Stream used for the uploads of uniformImage, created on first use.
+ */
+cudaStream_t CudaWorkspace::stream() {
+    if (!stream_) {
+        CHECK_CUDA(cudaStreamCreate(&stream_));
+    }
+    return stream_;
+}
+
+/**
+ * @brief Free the buffers and the stream.
+ */
+void CudaWorkspace::release() {
+    for (int slot = 0; slot < NumSlots; ++slot) {
+        if (buffers_[slot]) {
+            cudaFree(buffers_[slot]);
+            buffers_[slot] = nullptr;
+        }
+        capacities_[slot] = 0;
+    }
+    if (stream_) {
+        cudaStreamDestroy(stream_);
+        stream_ = nullptr;
+    }
+}
+
+/**
+ * @brief Process-wide workspace of uniformImage.
+ * 
+ * @return CudaWorkspace& The workspace.
+ */
+CudaWorkspace& cudaWorkspace() {
+    static CudaWorkspace workspace;
+    return workspace;
+}
+
+/**
+ * @brief Gather-sum the visibilities listed in a gridding plan into every grid cell.
+ * 
+ * One thread per (cell, direction); every cell is written exactly once.
+ * 
+ * @param grid Output grid in FFT-engine layout (every cell is written).
+ * @param visibilities Input visibilities of all directions.
+ * @param offsets Per-direction CSR cell offsets (num_cells + 1 entries per direction).
+ * @param indices Baseline indices of all directions, concatenated.
+ * @param index_bases Start of each direction's baseline indices in indices.
+ * @param image_size Size of the output image.
+ * @param num_visibilities Number of visibilities per direction.
+ * @param num_directions Number of directions.
+ */
+__global__ void gatherPlanCells(cufftDoubleComplex* grid, const cufftDoubleComplex* visibilities, const unsigned int* offsets,
+                                const unsigned int* indices, const unsigned long long* index_bases,
+                                int image_size, int num_visibilities, int num_directions) {
+    int num_cells = image_size * image_size;
+    int cell = blockIdx.x * blockDim.x + threadIdx.x;
+    int dir_idx = blockIdx.y;
+
+    if (dir_idx >= num_directions || cell >= num_cells) return;
+
+    const unsigned int* dir_offsets = offsets + static_cast<size_t>(dir_idx) * (num_cells + 1);
+    const unsigned int* dir_indices = indices + index_bases[dir_idx];
+    const cufftDoubleComplex* dir_vis = visibilities + static_cast<size_t>(dir_idx) * num_visibilities;
+
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    for (unsigned int k = dir_offsets[cell]; k < dir_offsets[cell + 1]; ++k) {
+        cufftDoubleComplex vis = dir_vis[dir_indices[k]];
+        sum_x += vis.x;
+        sum_y += vis.y;
+    }
+    int i_index = cell / image_size;
+    int j_index = cell % image_size;
+    double sign = gridStorageSign(i_index, j_index, image_size);
+    grid[static_cast<size_t>(dir_idx) * num_cells + gridStorageIndex(i_index, j_index, image_size)] = make_cuDoubleComplex(sign * sum_x, sign * sum_y);
+}
+
+/**
+ * @brief Generate uniform images from visibilities using a precomputed gridding plan.
+ * 
+ * No UVW coordinates are needed: every grid cell is the sum of the visibilities
+ * listed for it in the plan.
+ * 
+ * @param plan Gridding plan for the array geometry and directions.
+ * @param visibilities_batch Batch of visibilities for multiple directions (one entry per baseline).
+ * @param images Output images.
+ */
+void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+               std::vector<std::vector<double>>& images) {
+    int num_batches = plan.numDirections();
+    int image_size = plan.imageSize();
+    int num_cells = image_size * image_size;
+    int num_visibilities = plan.numBaselines();
+
+    std::vector<unsigned int> h_offsets(static_cast<size_t>(num_batches) * (num_cells + 1));
+    std::vector<unsigned long long> h_index_bases(num_batches);
+    unsigned long long total_indices = 0;
+    for (int b = 0; b < num_batches; ++b) {
+        std::copy(plan.cellOffsets(b).begin(), plan.cellOffsets(b).end(), h_offsets.begin() + static_cast<size_t>(b) * (num_cells + 1));
+        h_index_bases[b] = total_indices;
+        total_indices += plan.baselineIndices(b).size();
+    }
+
+    std::vector<unsigned int> h_indices(total_indices);
+    std::vector<cufftDoubleComplex> h_vis(static_cast<size_t>(num_batches) * num_visibilities);
+    for (int b = 0; b < num_batches; ++b) {
+        std::copy(plan.baselineIndices(b).begin(), plan.baselineIndices(b).end(), h_indices.begin() + h_index_bases[b]);
+        for (int i = 0; i < num_visibilities; ++i) {
+            h_vis[static_cast<size_t>(b) * num_visibilities + i] = make_cuDoubleComplex(visibilities_batch[b][i].real(), visibilities_batch[b][i].imag());
+        }
+    }
+
+    thrust::device_vector<unsigned int> d_offsets = h_offsets;
+    thrust::device_vector<unsigned int> d_indices = h_indices;
+    thrust::device_vector<unsigned long long> d_index_bases = h_index_bases;
+    thrust::device_vector<cufftDoubleComplex> d_vis = h_vis;
+
+    cufftDoubleComplex* d_visibility_grid;
+    CHECK_CUDA(cudaMalloc((void**)&d_visibility_grid, static_cast<size_t>(num_batches) * num_cells * sizeof(cufftDoubleComplex)));
+
+    int threadsPerBlock = 256;
+    dim3 blocksPerGrid((num_cells + threadsPerBlock - 1) / threadsPerBlock, num_batches);
+    gatherPlanCells<<<blocksPerGrid, threadsPerBlock>>>(d_visibility_grid,
+                                                        thrust::raw_pointer_cast(d_vis.data()),
+                                                        thrust::raw_pointer_cast(d_offsets.data()),
+                                                        thrust::raw_pointer_cast(d_indices.data()),
+                                                        thrust::raw_pointer_cast(d_index_bases.data()),
+                                                        image_size, num_visibilities, num_batches);
+    CHECK_CUDA(cudaGetLastError());
+    CHECK_CUDA(cudaDeviceSynchronize());
+
+    cudaFFTEngine<double>().toImages(d_visibility_grid, num_batches, image_size, images);
 
-    cudaStreamDestroy(stream2);
     cudaFree(d_visibility_grid);
 }
 
+/**
+ * @brief Compute the (direction, w-plane) sort key of every visibility for w-stacking.
+ * 
+ * @param w W coordinates of visibilities.
+ * @param w_min Start of the w range of every direction.
+ * @param w_step Plane spacing of every direction.
+ * @param num_planes Number of w-planes.
+ * @param num_visibilities Number of visibilities per direction.
+ * @param num_directions Number of directions.
+ * @param keys Output sort keys.
+ * @param vis_ids Output visibility indices (identity permutation).
+ */
+__global__ void computeWPlaneKeys(const double* w, const double* w_min, const double* w_step, int num_planes,
+                                  int num_visibilities, int num_directions, int* keys, int* vis_ids) {
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    int dir_idx = blockIdx.y;
+
+    if (dir_idx >= num_directions || idx >= num_visibilities) return;
+
+    int in = dir_idx * num_visibilities + idx;
+    keys[in] = dir_idx * num_planes + wPlaneIndex(w[in], w_min[dir_idx], w_step[dir_idx], num_planes);
+    vis_ids[in] = in;
+}
+
+/**
+ * @brief Map the visibilities of one w-plane to the grids of all directions.
+ * 
+ * Visibilities are read through the (direction, plane)-sorted index list, so each
+ * launch only touches the visibilities of its plane. The grid is written in
+ * FFT-engine layout (see gridStorageIndex).
+ * 
+ * @param grid Zero-initialized output grids for all directions.
+ * @param visibilities Input visibilities.
+ * @param u U coordinates of visibilities.
+ * @param v V coordinates of visibilities.
+ * @param vis_ids Visibility indices sorted by (direction, plane).
+ * @param offsets Start of every (direction, plane) run in vis_ids.
+ * @param plane The w-plane to grid.
+ * @param num_planes Number of w-planes.
+ * @param uv_max Maximum UV coordinate value.
+ * @param grid_res Resolution of the grid.
+ * @param image_size Size of the output image.
+ */
+__global__ void mapWPlaneVisibilities(cufftDoubleComplex* grid, const cufftDoubleComplex* visibilities, const double* u, const double* v,
+                                      const int* vis_ids, const int* offsets, int plane, int num_planes,
+                                      double uv_max, double grid_res, int image_size) {
+    int dir_idx = blockIdx.y;
+    int k = offsets[dir_idx * num_planes + plane] + blockIdx.x * blockDim.x + threadIdx.x;
+    if (k >= offsets[dir_idx * num_planes + plane + 1]) return;
+
+    int in = vis_ids[k];
+    int cell = gridCellIndex(u[in], v[in], uv_max, grid_res, image_size);
+    if (cell < 0) return;
+
+    int i_index = cell / image_size;
+    int j_index = cell % image_size;
+    size_t index = static_cast<size_t>(dir_idx) * image_size * image_size + gridStorageIndex(i_index, j_index, image_size);
+    double sign = gridStorageSign(i_index, j_index, image_size);
+    atomicAdd(&grid[index].x, sign * visibilities[in].x);
+    atomicAdd(&grid[index].y, sign * visibilities[in].y);
+}
+
+/**
+ * @brief Apply the phase screen of a w-plane to its transformed grids and accumulate them.
+ * 
+ * Both buffers are in FFT output layout; the screen is stored the same way (see wTermScreen).
+ * 
+ * @param accumulators Accumulated planes of all directions.
+ * @param grids Inverse-transformed plane of all directions.
+ * @param screen n - 1 of every FFT output element.
+ * @param w_planes Center w of the plane for every direction.
+ * @param image_size Size of the images.
+ */
+__global__ void accumulateWPlane(cufftDoubleComplex* accumulators, const cufftDoubleComplex* grids, const double* screen,
+                                 const double* w_planes, int image_size) {
+    int num_pixels = image_size * image_size;
+    int p = blockIdx.x * blockDim.x + threadIdx.x;
+    int dir_idx = blockIdx.y;
+    if (p >= num_pixels) return;
+
+    size_t index = static_cast<size_t>(dir_idx) * num_pixels + p;
+    double s, c;
+    sincos(2 * M_PI * w_planes[dir_idx] * screen[p], &s, &c);
+    cufftDoubleComplex value = grids[index];
+    accumulators[index].x += value.x * c - value.y * s;
+    accumulators[index].y += value.x * s + value.y * c;
+}
+
+/**
+ * @brief Generate wide-field images with w-stacking.
+ * 
+ * Visibilities are sorted once on the device by (direction, w-plane). Every non-empty
+ * plane is then gridded for all directions, transformed with one batched FFT,
+ * multiplied by the phase screen exp(2*pi*i*w_plane*(n - 1)) and accumulated; the real
+ * images are extracted once all planes are summed.
+ * 
+ * @param visibilities_batch Batch of visibilities for multiple directions.
+ * @param u_batch U coordinates for multiple directions.
+ * @param v_batch V coordinates for multiple directions.
+ * @param w_batch W coordinates for multiple directions.
+ * @param image_size Size of the output image.
+ * @param images Output images.
+ * @param use_predefined_params Flag to determine if predefined parameters should be used.
+ * @param num_w_planes Number of w-planes (0 = choose from the w range and field of view).
+ * @param plane_timings Output report of every imaged (non-empty) plane.
+ */
+void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                 const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                 const std::vector<std::vector<double>>& w_batch,
+                 int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                 int num_w_planes, std::vector<WPlaneTiming>& plane_timings) {
+    int num_batches = visibilities_batch.size();
+    images.resize(num_batches);
+    plane_timings.clear();
+    if (num_batches == 0) return;
+
+    int num_visibilities = visibilities_batch[0].size();
+    size_t total = static_cast<size_t>(num_batches) * num_visibilities;
+    size_t num_pixels = static_cast<size_t>(image_size) * image_size;
+
+    double max_uv = use_predefined_params ? config::PREDEFINED_MAX_UV : *std::max_element(u_batch[0].begin(), u_batch[0].end());
+    double uv_max, grid_res;
+    gridParameters(max_uv, image_size, uv_max, grid_res);
+
+    std::vector<WStackLayout> layouts = wStackLayouts(w_batch, image_size, grid_res, num_w_planes);
+    int num_planes = layouts[0].num_planes;
+    std::vector<double> h_w_min(num_batches), h_w_step(num_batches);
+    for (int b = 0; b < num_batches; ++b) {
+        h_w_min[b] = layouts[b].w_min;
+        h_w_step[b] = layouts[b].w_step;
+    }
+
+    std::vector<cufftDoubleComplex> h_vis(total);
+    std::vector<double> h_u(total), h_v(total), h_w(total);
+    for (int b = 0; b < num_batches; ++b) {
+        size_t base = static_cast<size_t>(b) * num_visibilities;
+        for (int i = 0; i < num_visibilities; ++i) {
+            h_vis[base + i] = make_cuDoubleComplex(visibilities_batch[b][i].real(), visibilities_batch[b][i].imag());
+        }
+        std::copy(u_batch[b].begin(), u_batch[b].end(), h_u.begin() + base);
+        std::copy(v_batch[b].begin(), v_batch[b].end(), h_v.begin() + base);
+        std::copy(w_batch[b].begin(), w_batch[b].end(), h_w.begin() + base);
+    }
+    thrust::device_vector<cufftDoubleComplex> d_vis = h_vis;
+    thrust::device_vector<double> d_u = h_u;
+    thrust::device_vector<double> d_v = h_v;
+    thrust::device_vector<double> d_w = h_w;
+    thrust::device_vector<double> d_w_min = h_w_min;
+    thrust::device_vector<double> d_w_step = h_w_step;
+    thrust::device_vector<double> d_screen = wTermScreen(image_size, grid_res);
+
+    // Bin the visibilities of every direction by w-plane
+    thrust::device_vector<int> d_keys(total);
+    thrust::device_vector<int> d_vis_ids(total);
+    int threadsPerBlock = 256;
+    dim3 keyBlocks((num_visibilities + threadsPerBlock - 1) / threadsPerBlock, num_batches);
+    computeWPlaneKeys<<<keyBlocks, threadsPerBlock>>>(thrust::raw_pointer_cast(d_w.data()),
+                                                      thrust::raw_pointer_cast(d_w_min.data()),
+                                                      thrust::raw_pointer_cast(d_w_step.data()),
+                                                      num_planes, num_visibilities, num_batches,
+                                                      thrust::raw_pointer_cast(d_keys.data()),
+                                                      thrust::raw_pointer_cast(d_vis_ids.data()));
+    CHECK_CUDA(cudaGetLastError());
+    thrust::sort_by_key(d_keys.begin(), d_keys.end(), d_vis_ids.begin());
+
+    int num_keys = num_batches * num_planes;
+    thrust::device_vector<int> d_offsets(num_keys + 1);
+    thrust::lower_bound(d_keys.begin(), d_keys.end(),
+                        thrust::counting_iterator<int>(0),
+                        thrust::counting_iterator<int>(num_keys + 1),
+                        d_offsets.begin());
+    thrust::host_vector<int> h_offsets = d_offsets;
+
+    cufftDoubleComplex* d_grids;
+    cufftDoubleComplex* d_accumulators;
+    size_t memSize = num_batches * num_pixels * sizeof(cufftDoubleComplex);
+    CHECK_CUDA(cudaMalloc((void**)&d_grids, memSize));
+    CHECK_CUDA(cudaMalloc((void**)&d_accumulators, memSize));
+    CHECK_CUDA(cudaMemset(d_accumulators, 0, memSize));
+
+    std::vector<double> h_w_planes(num_batches);
+    thrust::device_vector<double> d_w_planes(num_batches);
+    dim3 pixelBlocks((num_pixels + threadsPerBlock - 1) / threadsPerBlock, num_batches);
+
+    for (int p = 0; p < num_planes; ++p) {
+        size_t plane_visibilities = 0;
+        int max_run = 0;
+        for (int b = 0; b < num_batches; ++b) {
+            int run = h_offsets[b * num_planes + p + 1] - h_offsets[b * num_planes + p];
+            plane_visibilities += run;
+            max_run = std::max(max_run, run);
+            h_w_planes[b] = layouts[b].planeCenter(p);
+        }
+        if (plane_visibilities == 0) continue;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        CHECK_CUDA(cudaMemset(d_grids, 0, memSize));
+        dim3 visBlocks((max_run + threadsPerBlock - 1) / threadsPerBlock, num_batches);
+        mapWPlaneVisibilities<<<visBlocks, threadsPerBlock>>>(d_grids,
+                                                              thrust::raw_pointer_cast(d_vis.data()),
+                                                              thrust::raw_pointer_cast(d_u.data()),
+                                                              thrust::raw_pointer_cast(d_v.data()),
+                                                              thrust::raw_pointer_cast(d_vis_ids.data()),
+                                                              thrust::raw_pointer_cast(d_offsets.data()),
+                                                              p, num_planes, uv_max, grid_res, image_size);
+        CHECK_CUDA(cudaGetLastError());
+
+        cudaFFTEngine<double>().inverse(d_grids, num_batches, image_size);
+
+        thrust::copy(h_w_planes.begin(), h_w_planes.end(), d_w_planes.begin());
+        accumulateWPlane<<<pixelBlocks, threadsPerBlock>>>(d_accumulators, d_grids,
+                                                           thrust::raw_pointer_cast(d_screen.data()),
+                                                           thrust::raw_pointer_cast(d_w_planes.data()),
+                                                           image_size);
+        CHECK_CUDA(cudaGetLastError());
+        CHECK_CUDA(cudaDeviceSynchronize());
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        plane_timings.push_back({p, plane_visibilities, std::chrono::duration<double, std::milli>(stop - start).count()});
+    }
+
+    cudaFFTEngine<double>().extractImages(d_accumulators, num_batches, image_size, images);
+
+    cudaFree(d_grids);
+    cudaFree(d_accumulators);
+}
+
+/**
+ * @brief Generate uniform images from a visibility stream, one block at a time.
+ * 
+ * The grids of all directions stay on the device for the whole stream. Each block is
+ * copied into a fixed device buffer and scattered into the grid of its direction, so
+ * device memory holds the grids plus one block regardless of the size of the file.
+ * The stream reads the next block from disk while the current one is gridded.
+ * 
+ * @param stream Started visibility stream.
+ * @param image_size Size of the output image.
+ * @param max_uv Maximum UV distance used to size the grid.
+ * @param images Output images.
+ */
+void streamImage(VisibilityStream& stream, int image_size, double max_uv, std::vector<std::vector<double>>& images) {
+    const int num_batches = stream.numDirections();
+    images.resize(num_batches);
+    if (num_batches == 0) return;
+
+    double uv_max, grid_res;
+    gridParameters(max_uv, image_size, uv_max, grid_res);
+
+    const size_t num_cells = static_cast<size_t>(image_size) * image_size;
+    cufftDoubleComplex* d_grids;
+    CHECK_CUDA(cudaMalloc((void**)&d_grids, num_batches * num_cells * sizeof(cufftDoubleComplex)));
+    CHECK_CUDA(cudaMemset(d_grids, 0, num_batches * num_cells * sizeof(cufftDoubleComplex)));
+
+    const size_t block_size = stream.blockVisibilities();
+    thrust::device_vector<double> d_u(block_size);
+    thrust::device_vector<double> d_v(block_size);
+    thrust::device_vector<cufftDoubleComplex> d_vis(block_size);
+
+    int threadsPerBlock = 1024;
+    size_t sharedMemSize = threadsPerBlock * (sizeof(double) * 2 + sizeof(cufftDoubleComplex));
+    for (const VisibilityBlock* block = stream.next(); block; block = stream.next()) {
+        // std::complex<double> and cufftDoubleComplex have the same layout
+        CHECK_CUDA(cudaMemcpy(thrust::raw_pointer_cast(d_u.data()), block->u.data(), block->count * sizeof(double), cudaMemcpyHostToDevice));
+        CHECK_CUDA(cudaMemcpy(thrust::raw_pointer_cast(d_v.data()), block->v.data(), block->count * sizeof(double), cudaMemcpyHostToDevice));
+        CHECK_CUDA(cudaMemcpy(thrust::raw_pointer_cast(d_vis.data()), block->visibilities.data(),
+                              block->count * sizeof(cufftDoubleComplex), cudaMemcpyHostToDevice));
+
+        dim3 blocksPerGrid((block->count + threadsPerBlock - 1) / threadsPerBlock, 1);
+        mapVisibilitiesMultiDir<double, double><<<blocksPerGrid, threadsPerBlock, sharedMemSize>>>(
+            d_grids + block->direction * num_cells,
+            thrust::raw_pointer_cast(d_vis.data()),
+            thrust::raw_pointer_cast(d_u.data()),
+            thrust::raw_pointer_cast(d_v.data()),
+            uv_max, grid_res, image_size, block->count, 1);
+        CHECK_CUDA(cudaGetLastError());
+    }
+    CHECK_CUDA(cudaDeviceSynchronize());
+
+    cudaFFTEngine<double>().toImages(d_grids, num_batches, image_size, images);
+
+    cudaFree(d_grids);
+}
+
+/**
+ * @brief Generate a uniform image from visibilities using FFT.
+ * 
+ * @param visibilities_batch Batch of visibilities for multiple directions.
+ * @param u_batch U coordinates for multiple directions.
+ * @param v_batch V coordinates for multiple directions.
+ * @param image_size Size of the output image.
+ * @param images Output images.
+ * @param use_predefined_params Flag to determine if predefined parameters should be used.
+ * @param gridder Gridding strategy (atomic scatter or atomic-free tiled).
+ */
+template <typename UVWReal, typename GridReal>
+void uniformImage(const std::vector<std::vector<std::complex<GridReal>>>& visibilities_batch,
+                  const std::vector<std::vector<UVWReal>>& u_batch, const std::vector<std::vector<UVWReal>>& v_batch,
+                  int image_size, std::vector<std::vector<GridReal>>& images, bool use_predefined_params,
+                  GridderMode gridder) {
+    using Complex = typename CufftTypes<GridReal>::Complex;
+    int num_batches = visibilities_batch.size();
+    images.resize(num_batches);
+
+    // Grids and uv buffers come from the shared workspace and are reused across calls
+    CudaWorkspace& workspace = cudaWorkspace();
+    cudaStream_t stream = workspace.stream();
+
+    size_t memSize = num_batches * image_size * image_size * sizeof(Complex);
+    Complex* d_visibility_grid = static_cast<Complex*>(workspace.buffer(CudaWorkspace::Grids, memSize));
+
+    UVWReal* d_u = static_cast<UVWReal*>(workspace.buffer(CudaWorkspace::U, num_batches * u_batch[0].size() * sizeof(UVWReal)));
+    UVWReal* d_v = static_cast<UVWReal*>(workspace.buffer(CudaWorkspace::V, num_batches * v_batch[0].size() * sizeof(UVWReal)));
+
+    for (int b = 0; b < num_batches; ++b) {
+        CHECK_CUDA(cudaMemcpyAsync(d_u + b * u_batch[0].size(), 
+                                   u_batch[b].data(), 
+                                   u_batch[b].size() * sizeof(UVWReal), 
+                                   cudaMemcpyHostToDevice, 
+                                   stream));
+        CHECK_CUDA(cudaMemcpyAsync(d_v + b * v_batch[0].size(), 
+                                   v_batch[b].data(), 
+                                   v_batch[b].size() * sizeof(UVWReal), 
+                                   cudaMemcpyHostToDevice, 
+                                   stream));
+    }
+
+    CHECK_CUDA(cudaStreamSynchronize(stream));
+
+    double max_uv = use_predefined_params ? config::PREDEFINED_MAX_UV : *std::max_element(u_batch[0].begin(), u_batch[0].end());
+    double uv_max, grid_res;
+    gridParameters(max_uv, image_size, uv_max, grid_res);
+
+    if (gridder == GridderMode::Tiled) {
+        gridTiled(d_visibility_grid, visibilities_batch, d_u, d_v, uv_max, grid_res, image_size);
+    } else {
+        CHECK_CUDA(cudaMemset(d_visibility_grid, 0, memSize)); // Initialize memory to zero
+        gridScatter(d_visibility_grid, visibilities_batch, d_u, d_v, uv_max, grid_res, image_size);
+    }
+
+    cudaFFTEngine<GridReal>().toImages(d_visibility_grid, num_batches, image_size, images);
+}
+
+template void uniformImage<double, double>(const std::vector<std::vector<std::complex<double>>>&,
+                                           const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&,
+                                           int, std::vector<std::vector<double>>&, bool, GridderMode);
+template void uniformImage<float, float>(const std::vector<std::vector<std::complex<float>>>&,
+                                         const std::vector<std::vector<float>>&, const std::vector<std::vector<float>>&,
+                                         int, std::vector<std::vector<float>>&, bool, GridderMode);
+template void uniformImage<double, float>(const std::vector<std::vector<std::complex<float>>>&,
+                                          const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&,
+                                          int, std::vector<std::vector<float>>&, bool, GridderMode);
+
 /**
  * @brief CUDA kernel to compute UVW coordinates from XYZ coordinates for multiple directions.
  * 
  * @param x_m X coordinates of the antennas.
  * @param y_m Y coordinates of the antennas.
  * @param z_m Z coordinates of the antennas.
- * @param HAs Hour angles for multiple directions.
- * @param Decs Declinations for multiple directions.
+ * @param trig sin(HA), cos(HA), sin(Dec), cos(Dec) of every direction, precomputed on the host.
  * @param u Output U coordinates.
  * @param v Output V coordinates.
  * @param w Output W coordinates.
  * @param N Number of antennas.
  * @param num_directions Number of directions.
  */
-__global__ void computeUVWKernel(const double* x_m, const double* y_m, const double* z_m, 
-                                 const double* HAs, const double* Decs, 
-                                 double* u, double* v, double* w, int N, int num_directions) {
+template <typename Real>
+__global__ void computeUVWKernel(const Real* x_m, const Real* y_m, const Real* z_m, 
+                                 const Real* trig, 
+                                 Real* u, Real* v, Real* w, int N, int num_directions) {
     int idx = blockIdx.x * blockDim.x + threadIdx.x;
     int dir_idx = blockIdx.y;
 
     if (dir_idx >= num_directions || idx >= N * (N - 1) / 2) return;
 
-    double HA = HAs[dir_idx];
-    double Dec = Decs[dir_idx];
+    Real sin_ha = trig[4 * dir_idx];
+    Real cos_ha = trig[4 * dir_idx + 1];
+    Real sin_dec = trig[4 * dir_idx + 2];
+    Real cos_dec = trig[4 * dir_idx + 3];
 
     // Calculate the baseline indices
     int i = static_cast<int>(sqrt(2 * idx + 0.25) - 0.5);
     int j = idx - i * (i + 1) / 2;
 
     if (i < N && j < N) {
-        double dx = x_m[j] - x_m[i];
-        double dy = y_m[j] - y_m[i];
-        double dz = z_m[j] - z_m[i];
+        Real dx = x_m[j] - x_m[i];
+        Real dy = y_m[j] - y_m[i];
+        Real dz = z_m[j] - z_m[i];
 
-        double u_ij = dx * sin(HA) + dy * cos(HA);
-        double v_ij = -dx * sin(Dec) * cos(HA) + dy * sin(Dec) * sin(HA) + dz * cos(Dec);
-        double w_ij = dx * cos(Dec) * cos(HA) - dy * cos(Dec) * sin(HA) + dz * sin(Dec);
+        Real u_ij = dx * sin_ha + dy * cos_ha;
+        Real v_ij = -dx * sin_dec * cos_ha + dy * sin_dec * sin_ha + dz * cos_dec;
+        Real w_ij = dx * cos_dec * cos_ha - dy * cos_dec * sin_ha + dz * sin_dec;
 
         int index = dir_idx * N * (N - 1) / 2 + idx;
         u[index] = u_ij;
@@ -371,26 +1159,39 @@ __global__ void computeUVWKernel(const double* x_m, const double* y_m, const dou
  * @param w Output W coordinates for multiple directions.
  * @param use_predefined_params Flag to determine if predefined parameters should be used.
  */
+template <typename Real>
 void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m, 
                 const std::vector<double>& HAs, const std::vector<double>& Decs, 
-                std::vector<std::vector<double>>& u, std::vector<std::vector<double>>& v, std::vector<std::vector<double>>& w) {
+                std::vector<std::vector<Real>>& u, std::vector<std::vector<Real>>& v, std::vector<std::vector<Real>>& w) {
     int N = x_m.size();
     int num_directions = HAs.size();
     int num_baselines = N * (N - 1) / 2;
 
-    // Resize output vectors
-    u.resize(num_directions, std::vector<double>(num_baselines));
-    v.resize(num_directions, std::vector<double>(num_baselines));
-    w.resize(num_directions, std::vector<double>(num_baselines));
+    // Resize output vectors (keeping their storage, so repeated calls do not reallocate)
+    u.resize(num_directions);
+    v.resize(num_directions);
+    w.resize(num_directions);
+    for (int d = 0; d < num_directions; ++d) {
+        u[d].resize(num_baselines);
+        v[d].resize(num_baselines);
+        w[d].resize(num_baselines);
+    }
+
+    std::vector<Real> h_trig(4 * num_directions);
+    for (int d = 0; d < num_directions; ++d) {
+        h_trig[4 * d] = static_cast<Real>(std::sin(HAs[d]));
+        h_trig[4 * d + 1] = static_cast<Real>(std::cos(HAs[d]));
+        h_trig[4 * d + 2] = static_cast<Real>(std::sin(Decs[d]));
+        h_trig[4 * d + 3] = static_cast<Real>(std::cos(Decs[d]));
+    }
 
-    thrust::device_vector<double> d_x_m = x_m;
-    thrust::device_vector<double> d_y_m = y_m;
-    thrust::device_vector<double> d_z_m = z_m;
-    thrust::device_vector<double> d_HAs = HAs;
-    thrust::device_vector<double> d_Decs = Decs;
-    thrust::device_vector<double> d_u(num_directions * num_baselines);
-    thrust::device_vector<double> d_v(num_directions * num_baselines);
-    thrust::device_vector<double> d_w(num_directions * num_baselines);
+    thrust::device_vector<Real> d_x_m(x_m.begin(), x_m.end());
+    thrust::device_vector<Real> d_y_m(y_m.begin(), y_m.end());
+    thrust::device_vector<Real> d_z_m(z_m.begin(), z_m.end());
+    thrust::device_vector<Real> d_trig = h_trig;
+    thrust::device_vector<Real> d_u(num_directions * num_baselines);
+    thrust::device_vector<Real> d_v(num_directions * num_baselines);
+    thrust::device_vector<Real> d_w(num_directions * num_baselines);
 
     int threadsPerBlock = 256;
     dim3 blocksPerGrid((num_baselines + threadsPerBlock - 1) / threadsPerBlock, num_directions);
@@ -398,8 +1199,7 @@ void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m,
     computeUVWKernel<<<blocksPerGrid, threadsPerBlock>>>(thrust::raw_pointer_cast(d_x_m.data()), 
                                                          thrust::raw_pointer_cast(d_y_m.data()), 
                                                          thrust::raw_pointer_cast(d_z_m.data()), 
-                                                         thrust::raw_pointer_cast(d_HAs.data()), 
-                                                         thrust::raw_pointer_cast(d_Decs.data()), 
+                                                         thrust::raw_pointer_cast(d_trig.data()), 
                                                          thrust::raw_pointer_cast(d_u.data()), 
                                                          thrust::raw_pointer_cast(d_v.data()), 
                                                          thrust::raw_pointer_cast(d_w.data()), N, num_directions);
@@ -412,3 +1212,88 @@ void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m,
         thrust::copy(d_w.begin() + d * num_baselines, d_w.begin() + (d + 1) * num_baselines, w[d].begin());
     }
 }
+
+template void computeUVW<float>(const std::vector<double>&, const std::vector<double>&, const std::vector<double>&,
+                                const std::vector<double>&, const std::vector<double>&,
+                                std::vector<std::vector<float>>&, std::vector<std::vector<float>>&, std::vector<std::vector<float>>&);
+template void computeUVW<double>(const std::vector<double>&, const std::vector<double>&, const std::vector<double>&,
+                                 const std::vector<double>&, const std::vector<double>&,
+                                 std::vector<std::vector<double>>&, std::vector<std::vector<double>>&, std::vector<std::vector<double>>&);
+
+/**
+ * @brief ImagingBackend implementation backed by the CUDA engine.
+ */
+class CudaBackend : public ImagingBackend {
+public:
+    ~CudaBackend() override {
+        cudaWorkspace().release();
+        cudaFFTEngine<float>().release();
+        cudaFFTEngine<double>().release();
+
+        // Reset the GPU
+        cudaDeviceReset();
+    }
+
+    const char* name() const override { return "cuda"; }
+
+    void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                    const std::vector<double>& HAs, const std::vector<double>& Decs,
+                    std::vector<std::vector<double>>& u, std::vector<std::vector<double>>& v, std::vector<std::vector<double>>& w) override {
+        ::computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w);
+    }
+
+    void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                    const std::vector<double>& HAs, const std::vector<double>& Decs,
+                    std::vector<std::vector<float>>& u, std::vector<std::vector<float>>& v, std::vector<std::vector<float>>& w) override {
+        ::computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w);
+    }
+
+    void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                      const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                      int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                      GridderMode gridder) override {
+        ::uniformImage(visibilities_batch, u_batch, v_batch, image_size, images, use_predefined_params, gridder);
+    }
+
+    void uniformImage(const std::vector<std::vector<std::complex<float>>>& visibilities_batch,
+                      const std::vector<std::vector<float>>& u_batch, const std::vector<std::vector<float>>& v_batch,
+                      int image_size, std::vector<std::vector<float>>& images, bool use_predefined_params,
+                      GridderMode gridder) override {
+        ::uniformImage(visibilities_batch, u_batch, v_batch, image_size, images, use_predefined_params, gridder);
+    }
+
+    void uniformImage(const std::vector<std::vector<std::complex<float>>>& visibilities_batch,
+                      const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                      int image_size, std::vector<std::vector<float>>& images, bool use_predefined_params,
+                      GridderMode gridder) override {
+        ::uniformImage(visibilities_batch, u_batch, v_batch, image_size, images, use_predefined_params, gridder);
+    }
+
+    void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                   std::vector<std::vector<double>>& images) override {
+        ::planImage(plan, visibilities_batch, images);
+    }
+
+    void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                     const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                     const std::vector<std::vector<double>>& w_batch,
+                     int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                     int num_w_planes, std::vector<WPlaneTiming>& plane_timings) override {
+        ::wStackImage(visibilities_batch, u_batch, v_batch, w_batch, image_size, images, use_predefined_params,
+                      num_w_planes, plane_timings);
+    }
+
+    void streamImage(VisibilityStream& stream, int image_size, double max_uv,
+                     std::vector<std::vector<double>>& images) override {
+        ::streamImage(stream, image_size, max_uv, images);
+    }
+};
+
+/**
+ * @brief Create the CUDA imaging backend.
+ * 
+ * @return std::unique_ptr<ImagingBackend> The CUDA backend.
+ */
+std::unique_ptr<ImagingBackend> makeCudaBackend() {
+    return std::make_unique<CudaBackend>();
+}
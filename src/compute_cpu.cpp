@@ -0,0 +1,682 @@
+#include "config.hpp"
+#include "compute_cpu.hpp"
+#include "backend.hpp"
+#include "parallel.hpp"
+#include "fft_engine.hpp"
+#include "wstacking.hpp"
+#include "visibility_io.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace {
+
+/// Number of visibilities whose cells are computed together before they are accumulated.
+constexpr size_t GRID_BLOCK_SIZE = 256;
+
+/**
+ * @brief Maximum uv distance used to size the grid, as in the CUDA uniformImage.
+ */
+template <typename UVWReal>
+double maxUV(const std::vector<std::vector<UVWReal>>& u_batch, bool use_predefined_params) {
+    return use_predefined_params ? config::PREDEFINED_MAX_UV : *std::max_element(u_batch[0].begin(), u_batch[0].end());
+}
+
+/**
+ * @brief Cells of a block of visibilities (at most GRID_BLOCK_SIZE).
+ *
+ * Kept separate from the scattered accumulation so that the compiler can vectorize
+ * it over the contiguous u and v arrays. The index arithmetic is done in UVWReal.
+ */
+template <typename UVWReal>
+void gridCells(int* cells, const UVWReal* u, const UVWReal* v, size_t count, double uv_max, double grid_res, int image_size) {
+    const UVWReal uv_max_r = static_cast<UVWReal>(uv_max);
+    const UVWReal grid_res_r = static_cast<UVWReal>(grid_res);
+    for (size_t k = 0; k < count; ++k) {
+        cells[k] = gridCellIndex(u[k], v[k], uv_max_r, grid_res_r, image_size);
+    }
+}
+
+/**
+ * @brief Accumulate a range of visibilities of one direction into a private grid.
+ *
+ * The grid is written in FFT-engine layout (see gridStorageIndex).
+ */
+template <typename UVWReal, typename GridReal>
+void gridRange(std::complex<GridReal>* grid, const std::complex<GridReal>* visibilities, const UVWReal* u, const UVWReal* v,
+               size_t begin, size_t end, double uv_max, double grid_res, int image_size) {
+    int cells[GRID_BLOCK_SIZE];
+    for (size_t block = begin; block < end; block += GRID_BLOCK_SIZE) {
+        size_t count = std::min(GRID_BLOCK_SIZE, end - block);
+        gridCells(cells, u + block, v + block, count, uv_max, grid_res, image_size);
+        for (size_t k = 0; k < count; ++k) {
+            int cell = cells[k];
+            if (cell >= 0) {
+                int i = cell / image_size;
+                int j = cell % image_size;
+                grid[gridStorageIndex(i, j, image_size)] += static_cast<GridReal>(gridStorageSign(i, j, image_size)) * visibilities[block + k];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Scatter gridder: per-thread private grids summed with a parallel reduction.
+ *
+ * @param private_grids Scratch grids; on return private_grids[0] holds the gridded direction.
+ */
+template <typename UVWReal, typename GridReal>
+void gridDirectionScatter(std::vector<std::vector<std::complex<GridReal>>>& private_grids,
+                          const std::vector<std::complex<GridReal>>& visibilities, const std::vector<UVWReal>& u, const std::vector<UVWReal>& v,
+                          double uv_max, double grid_res, int image_size, unsigned num_threads) {
+    const size_t num_cells = static_cast<size_t>(image_size) * image_size;
+    const size_t num_vis = visibilities.size();
+    const size_t min_block = 16384;
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(num_threads, num_vis / min_block));
+    private_grids.resize(std::max<size_t>(private_grids.size(), chunks));
+
+    parallelFor(chunks, num_threads, [&](size_t chunk_begin, size_t chunk_end, size_t) {
+        for (size_t c = chunk_begin; c < chunk_end; ++c) {
+            private_grids[c].assign(num_cells, std::complex<GridReal>(0, 0));
+            size_t begin = c * num_vis / chunks;
+            size_t end = (c + 1) * num_vis / chunks;
+            gridRange(private_grids[c].data(), visibilities.data(), u.data(), v.data(), begin, end, uv_max, grid_res, image_size);
+        }
+    });
+
+    // Parallel reduction of the private grids into the first one
+    std::vector<std::complex<GridReal>>& grid = private_grids[0];
+    if (chunks > 1) {
+        parallelFor(num_cells, num_threads, [&](size_t cell_begin, size_t cell_end, size_t) {
+            for (size_t c = 1; c < chunks; ++c) {
+                const std::complex<GridReal>* src = private_grids[c].data();
+                for (size_t cell = cell_begin; cell < cell_end; ++cell) {
+                    grid[cell] += src[cell];
+                }
+            }
+        });
+    }
+}
+
+/**
+ * @brief Tiled gridder: bin visibilities by uv tile, then accumulate each tile once.
+ *
+ * Each tile is owned by exactly one worker, which sums its visibilities into a small
+ * cache-resident buffer and writes the tile back to the grid in a single pass. Within
+ * a tile visibilities are summed in their original order, so the result does not
+ * depend on the number of threads.
+ *
+ * @param grid Output grid in FFT-engine layout; every cell is overwritten.
+ */
+template <typename UVWReal, typename GridReal>
+void gridDirectionTiled(std::vector<std::complex<GridReal>>& grid,
+                        const std::vector<std::complex<GridReal>>& visibilities, const std::vector<UVWReal>& u, const std::vector<UVWReal>& v,
+                        double uv_max, double grid_res, int image_size, unsigned num_threads) {
+    const size_t num_vis = visibilities.size();
+    const int tiles_per_row = (image_size + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+    const int num_tiles = tiles_per_row * tiles_per_row;
+
+    std::vector<int> cells(num_vis);
+    std::vector<int> tiles(num_vis);
+    parallelFor(num_vis, num_threads, [&](size_t begin, size_t end, size_t) {
+        gridCells(cells.data() + begin, u.data() + begin, v.data() + begin, end - begin, uv_max, grid_res, image_size);
+        for (size_t k = begin; k < end; ++k) {
+            int cell = cells[k];
+            tiles[k] = cell < 0 ? -1 : ((cell / image_size) / GRID_TILE_SIZE) * tiles_per_row + (cell % image_size) / GRID_TILE_SIZE;
+        }
+    });
+
+    std::vector<size_t> tile_offsets;
+    std::vector<size_t> order;
+    cpu::countingSort(tiles, num_tiles, num_threads, tile_offsets, order);
+
+    grid.resize(static_cast<size_t>(image_size) * image_size);
+    parallelFor(num_tiles, num_threads, [&](size_t tile_begin, size_t tile_end, size_t) {
+        std::complex<GridReal> local[GRID_TILE_SIZE * GRID_TILE_SIZE];
+        for (size_t t = tile_begin; t < tile_end; ++t) {
+            int row0 = static_cast<int>(t / tiles_per_row) * GRID_TILE_SIZE;
+            int col0 = static_cast<int>(t % tiles_per_row) * GRID_TILE_SIZE;
+            std::fill(std::begin(local), std::end(local), std::complex<GridReal>(0, 0));
+
+            for (size_t pos = tile_offsets[t]; pos < tile_offsets[t + 1]; ++pos) {
+                size_t k = order[pos];
+                int cell = cells[k];
+                int li = cell / image_size - row0;
+                int lj = cell % image_size - col0;
+                local[li * GRID_TILE_SIZE + lj] += visibilities[k];
+            }
+
+            int rows = std::min(GRID_TILE_SIZE, image_size - row0);
+            int cols = std::min(GRID_TILE_SIZE, image_size - col0);
+            for (int li = 0; li < rows; ++li) {
+                for (int lj = 0; lj < cols; ++lj) {
+                    int i = row0 + li;
+                    int j = col0 + lj;
+                    grid[gridStorageIndex(i, j, image_size)] = static_cast<GridReal>(gridStorageSign(i, j, image_size)) * local[li * GRID_TILE_SIZE + lj];
+                }
+            }
+        }
+    });
+}
+
+}
+
+namespace cpu {
+
+/**
+ * @brief Stable parallel counting sort of item indices by bin.
+ *
+ * Each thread histograms a contiguous slice of the items, a prefix sum over
+ * (bin, slice) gives every slice its write position, and the slices are then
+ * scattered independently. Items with a negative bin are dropped.
+ *
+ * @param bins Bin of each item (negative to skip the item).
+ * @param num_bins Number of bins.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ * @param offsets Output CSR offsets, num_bins + 1 entries.
+ * @param order Output item indices grouped by bin, in ascending item order within a bin.
+ */
+void countingSort(const std::vector<int>& bins, int num_bins, unsigned num_threads,
+                  std::vector<size_t>& offsets, std::vector<size_t>& order) {
+    const size_t num_items = bins.size();
+    const size_t min_block = 65536;
+    size_t slices = std::max<size_t>(1, std::min<size_t>(resolveThreadCount(num_threads), num_items / min_block));
+
+    std::vector<std::vector<size_t>> counts(slices, std::vector<size_t>(num_bins, 0));
+    parallelFor(slices, num_threads, [&](size_t slice_begin, size_t slice_end, size_t) {
+        for (size_t s = slice_begin; s < slice_end; ++s) {
+            size_t begin = s * num_items / slices;
+            size_t end = (s + 1) * num_items / slices;
+            for (size_t k = begin; k < end; ++k) {
+                if (bins[k] >= 0) ++counts[s][bins[k]];
+            }
+        }
+    });
+
+    offsets.assign(num_bins + 1, 0);
+    size_t running = 0;
+    for (int b = 0; b < num_bins; ++b) {
+        offsets[b] = running;
+        for (size_t s = 0; s < slices; ++s) {
+            size_t count = counts[s][b];
+            counts[s][b] = running;
+            running += count;
+        }
+    }
+    offsets[num_bins] = running;
+
+    order.resize(running);
+    parallelFor(slices, num_threads, [&](size_t slice_begin, size_t slice_end, size_t) {
+        for (size_t s = slice_begin; s < slice_end; ++s) {
+            size_t begin = s * num_items / slices;
+            size_t end = (s + 1) * num_items / slices;
+            for (size_t k = begin; k < end; ++k) {
+                if (bins[k] >= 0) order[counts[s][bins[k]]++] = k;
+            }
+        }
+    });
+}
+
+/**
+ * @brief Compute UVW coordinates from XYZ coordinates for multiple directions on the CPU.
+ *
+ * Work is split across (direction, baseline range) pairs so that both many-direction
+ * and many-baseline inputs keep every thread busy. The baseline enumeration matches
+ * computeUVWKernel exactly. Inside a range, baselines are walked antenna row by
+ * antenna row: the baselines (i, 0..i) of row i are contiguous in the output, and the
+ * direction's sines and cosines are hoisted, so the inner loop is a vectorizable
+ * pass over the structure-of-arrays antenna coordinates.
+ *
+ * @param x_m X coordinates of the antennas.
+ * @param y_m Y coordinates of the antennas.
+ * @param z_m Z coordinates of the antennas.
+ * @param HAs Hour angles for multiple directions.
+ * @param Decs Declinations for multiple directions.
+ * @param u Output U coordinates for multiple directions.
+ * @param v Output V coordinates for multiple directions.
+ * @param w Output W coordinates for multiple directions.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+template <typename Real>
+void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                const std::vector<double>& HAs, const std::vector<double>& Decs,
+                std::vector<std::vector<Real>>& u, std::vector<std::vector<Real>>& v, std::vector<std::vector<Real>>& w,
+                unsigned num_threads) {
+    int N = x_m.size();
+    int num_directions = HAs.size();
+    size_t num_baselines = static_cast<size_t>(N) * (N - 1) / 2;
+
+    // Resize the outputs in place, so repeated calls reuse their storage
+    u.resize(num_directions);
+    v.resize(num_directions);
+    w.resize(num_directions);
+    for (int d = 0; d < num_directions; ++d) {
+        u[d].resize(num_baselines);
+        v[d].resize(num_baselines);
+        w[d].resize(num_baselines);
+    }
+
+    const std::vector<Real> x(x_m.begin(), x_m.end());
+    const std::vector<Real> y(y_m.begin(), y_m.end());
+    const std::vector<Real> z(z_m.begin(), z_m.end());
+
+    const size_t min_block = 4096;
+    unsigned threads = resolveThreadCount(num_threads);
+    size_t blocks_per_dir = std::max<size_t>(1, std::min<size_t>((threads + num_directions - 1) / std::max(num_directions, 1),
+                                                                 (num_baselines + min_block - 1) / min_block));
+    size_t block_size = (num_baselines + blocks_per_dir - 1) / blocks_per_dir;
+
+    parallelFor(num_directions * blocks_per_dir, threads, [&](size_t item_begin, size_t item_end, size_t) {
+        for (size_t item = item_begin; item < item_end; ++item) {
+            size_t d = item / blocks_per_dir;
+            size_t begin = (item % blocks_per_dir) * block_size;
+            size_t end = std::min(begin + block_size, num_baselines);
+            if (begin >= end) continue;
+
+            const Real sin_ha = static_cast<Real>(std::sin(HAs[d]));
+            const Real cos_ha = static_cast<Real>(std::cos(HAs[d]));
+            const Real sin_dec = static_cast<Real>(std::sin(Decs[d]));
+            const Real cos_dec = static_cast<Real>(std::cos(Decs[d]));
+            Real* u_d = u[d].data();
+            Real* v_d = v[d].data();
+            Real* w_d = w[d].data();
+
+            // Calculate the baseline indices of the first baseline of the range
+            int i = static_cast<int>(std::sqrt(2 * begin + 0.25) - 0.5);
+            size_t row_start = static_cast<size_t>(i) * (i + 1) / 2;
+
+            for (size_t idx = begin; idx < end; ++i) {
+                // Baselines (i, j_begin..j_end) of this row that fall in the range
+                int j_begin = static_cast<int>(idx - row_start);
+                int j_end = static_cast<int>(std::min<size_t>(row_start + i + 1, end) - row_start);
+                const Real x_i = x[i];
+                const Real y_i = y[i];
+                const Real z_i = z[i];
+                Real* u_row = u_d + row_start;
+                Real* v_row = v_d + row_start;
+                Real* w_row = w_d + row_start;
+
+                for (int j = j_begin; j < j_end; ++j) {
+                    Real dx = x[j] - x_i;
+                    Real dy = y[j] - y_i;
+                    Real dz = z[j] - z_i;
+
+                    u_row[j] = dx * sin_ha + dy * cos_ha;
+                    v_row[j] = -dx * sin_dec * cos_ha + dy * sin_dec * sin_ha + dz * cos_dec;
+                    w_row[j] = dx * cos_dec * cos_ha - dy * cos_dec * sin_ha + dz * sin_dec;
+                }
+
+                idx = row_start + j_end;
+                row_start += i + 1;
+            }
+        }
+    });
+}
+
+/**
+ * @brief Generate uniform images from visibilities on the CPU.
+ *
+ * Directions are processed concurrently. Inside a direction, the scatter gridder
+ * splits baselines across threads that each grid into a private grid; the private
+ * grids are then summed with a parallel reduction over grid cells. The tiled
+ * gridder bins visibilities by uv tile and accumulates every tile once. Neither
+ * needs atomics.
+ *
+ * @param visibilities_batch Batch of visibilities for multiple directions.
+ * @param u_batch U coordinates for multiple directions.
+ * @param v_batch V coordinates for multiple directions.
+ * @param image_size Size of the output image.
+ * @param images Output images.
+ * @param use_predefined_params Flag to determine if predefined parameters should be used.
+ * @param gridder Gridding strategy (scatter or tiled).
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+template <typename UVWReal, typename GridReal>
+void uniformImage(const std::vector<std::vector<std::complex<GridReal>>>& visibilities_batch,
+                  const std::vector<std::vector<UVWReal>>& u_batch, const std::vector<std::vector<UVWReal>>& v_batch,
+                  int image_size, std::vector<std::vector<GridReal>>& images, bool use_predefined_params,
+                  GridderMode gridder, unsigned num_threads) {
+    int num_batches = visibilities_batch.size();
+    images.resize(num_batches);
+    if (num_batches == 0) return;
+
+    double uv_max, grid_res;
+    gridParameters(maxUV(u_batch, use_predefined_params), image_size, uv_max, grid_res);
+
+    const size_t num_pixels = static_cast<size_t>(image_size) * image_size;
+    unsigned threads = resolveThreadCount(num_threads);
+    unsigned dir_workers = std::min<unsigned>(threads, num_batches);
+    unsigned threads_per_dir = std::max(1u, threads / dir_workers);
+
+    parallelFor(num_batches, dir_workers, [&](size_t dir_begin, size_t dir_end, size_t) {
+        // Kept per thread, so long-lived callers (the workers of --serve) reuse the grid storage
+        thread_local std::vector<std::vector<std::complex<GridReal>>> private_grids(1);
+
+        for (size_t b = dir_begin; b < dir_end; ++b) {
+            if (gridder == GridderMode::Tiled) {
+                gridDirectionTiled(private_grids[0], visibilities_batch[b], u_batch[b], v_batch[b], uv_max, grid_res, image_size, threads_per_dir);
+            } else {
+                gridDirectionScatter(private_grids, visibilities_batch[b], u_batch[b], v_batch[b], uv_max, grid_res, image_size, threads_per_dir);
+            }
+            images[b].resize(num_pixels);
+            cpuFFTEngine<GridReal>().toImage(private_grids[0].data(), image_size, images[b].data(), threads_per_dir);
+        }
+    });
+}
+
+template void computeUVW<float>(const std::vector<double>&, const std::vector<double>&, const std::vector<double>&,
+                                const std::vector<double>&, const std::vector<double>&,
+                                std::vector<std::vector<float>>&, std::vector<std::vector<float>>&, std::vector<std::vector<float>>&, unsigned);
+template void computeUVW<double>(const std::vector<double>&, const std::vector<double>&, const std::vector<double>&,
+                                 const std::vector<double>&, const std::vector<double>&,
+                                 std::vector<std::vector<double>>&, std::vector<std::vector<double>>&, std::vector<std::vector<double>>&, unsigned);
+
+template void uniformImage<double, double>(const std::vector<std::vector<std::complex<double>>>&,
+                                           const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&,
+                                           int, std::vector<std::vector<double>>&, bool, GridderMode, unsigned);
+template void uniformImage<float, float>(const std::vector<std::vector<std::complex<float>>>&,
+                                         const std::vector<std::vector<float>>&, const std::vector<std::vector<float>>&,
+                                         int, std::vector<std::vector<float>>&, bool, GridderMode, unsigned);
+template void uniformImage<double, float>(const std::vector<std::vector<std::complex<float>>>&,
+                                          const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&,
+                                          int, std::vector<std::vector<float>>&, bool, GridderMode, unsigned);
+
+
+/**
+ * @brief Generate uniform images from visibilities using a precomputed gridding plan.
+ *
+ * Every grid cell is the sum of the visibilities listed for it in the plan, so
+ * gridding is a pure gather: no UVW coordinates or cell indices are computed.
+ *
+ * @param plan Gridding plan for the array geometry and directions.
+ * @param visibilities_batch Batch of visibilities for multiple directions (one entry per baseline).
+ * @param images Output images.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+               std::vector<std::vector<double>>& images, unsigned num_threads) {
+    int num_batches = plan.numDirections();
+    int image_size = plan.imageSize();
+    images.resize(num_batches);
+    if (num_batches == 0) return;
+
+    const size_t num_cells = static_cast<size_t>(image_size) * image_size;
+    unsigned threads = resolveThreadCount(num_threads);
+    unsigned dir_workers = std::min<unsigned>(threads, num_batches);
+    unsigned threads_per_dir = std::max(1u, threads / dir_workers);
+
+    parallelFor(num_batches, dir_workers, [&](size_t dir_begin, size_t dir_end, size_t) {
+        std::vector<std::complex<double>> grid(num_cells);
+
+        for (size_t b = dir_begin; b < dir_end; ++b) {
+            const std::uint32_t* offsets = plan.cellOffsets(b).data();
+            const std::uint32_t* indices = plan.baselineIndices(b).data();
+            const std::complex<double>* visibilities = visibilities_batch[b].data();
+
+            parallelFor(num_cells, threads_per_dir, [&](size_t cell_begin, size_t cell_end, size_t) {
+                for (size_t cell = cell_begin; cell < cell_end; ++cell) {
+                    std::complex<double> sum(0.0, 0.0);
+                    for (std::uint32_t k = offsets[cell]; k < offsets[cell + 1]; ++k) {
+                        sum += visibilities[indices[k]];
+                    }
+                    int i = cell / image_size;
+                    int j = cell % image_size;
+                    grid[gridStorageIndex(i, j, image_size)] = gridStorageSign(i, j, image_size) * sum;
+                }
+            });
+
+            images[b].resize(num_cells);
+            cpuFFTEngine<double>().toImage(grid.data(), image_size, images[b].data(), threads_per_dir);
+        }
+    });
+}
+
+
+/**
+ * @brief Generate wide-field images with w-stacking on the CPU.
+ *
+ * Visibilities are binned by w with a counting sort per direction (see wStackLayouts).
+ * Every non-empty w-plane is gridded with the scatter gridder, inverse transformed, multiplied by
+ * the phase screen exp(2*pi*i*w_plane*(n - 1)) of its center and accumulated; the
+ * real image is extracted once all planes are summed.
+ *
+ * @param visibilities_batch Batch of visibilities for multiple directions.
+ * @param u_batch U coordinates for multiple directions.
+ * @param v_batch V coordinates for multiple directions.
+ * @param w_batch W coordinates for multiple directions.
+ * @param image_size Size of the output image.
+ * @param images Output images.
+ * @param use_predefined_params Flag to determine if predefined parameters should be used.
+ * @param num_w_planes Number of w-planes (0 = choose from the w range and field of view).
+ * @param plane_timings Output report of every imaged (non-empty) plane.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                 const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                 const std::vector<std::vector<double>>& w_batch,
+                 int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                 int num_w_planes, std::vector<WPlaneTiming>& plane_timings, unsigned num_threads) {
+    int num_batches = visibilities_batch.size();
+    images.resize(num_batches);
+    plane_timings.clear();
+    if (num_batches == 0) return;
+
+    double uv_max, grid_res;
+    gridParameters(maxUV(u_batch, use_predefined_params), image_size, uv_max, grid_res);
+    const std::vector<WStackLayout> layouts = wStackLayouts(w_batch, image_size, grid_res, num_w_planes);
+    const int num_planes = layouts[0].num_planes;
+    const std::vector<double> screen = wTermScreen(image_size, grid_res);
+
+    // Bin the visibilities of every direction by w-plane
+    std::vector<std::vector<size_t>> plane_offsets(num_batches);
+    std::vector<std::vector<size_t>> plane_order(num_batches);
+    std::vector<int> planes;
+    for (int b = 0; b < num_batches; ++b) {
+        const std::vector<double>& w = w_batch[b];
+        planes.resize(w.size());
+        parallelFor(w.size(), num_threads, [&](size_t begin, size_t end, size_t) {
+            for (size_t k = begin; k < end; ++k) {
+                planes[k] = wPlaneIndex(w[k], layouts[b].w_min, layouts[b].w_step, num_planes);
+            }
+        });
+        countingSort(planes, num_planes, num_threads, plane_offsets[b], plane_order[b]);
+    }
+
+    const size_t num_pixels = static_cast<size_t>(image_size) * image_size;
+    unsigned threads = resolveThreadCount(num_threads);
+    unsigned dir_workers = std::min<unsigned>(threads, num_batches);
+    unsigned threads_per_dir = std::max(1u, threads / dir_workers);
+
+    std::vector<std::vector<std::complex<double>>> accumulators(num_batches, std::vector<std::complex<double>>(num_pixels));
+
+    for (int p = 0; p < num_planes; ++p) {
+        size_t plane_visibilities = 0;
+        for (int b = 0; b < num_batches; ++b) {
+            plane_visibilities += plane_offsets[b][p + 1] - plane_offsets[b][p];
+        }
+        if (plane_visibilities == 0) continue;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        parallelFor(num_batches, dir_workers, [&](size_t dir_begin, size_t dir_end, size_t) {
+            std::vector<std::vector<std::complex<double>>> private_grids(1);
+            std::vector<std::complex<double>> visibilities;
+            std::vector<double> u;
+            std::vector<double> v;
+
+            for (size_t b = dir_begin; b < dir_end; ++b) {
+                size_t begin = plane_offsets[b][p];
+                size_t end = plane_offsets[b][p + 1];
+                if (begin == end) continue;
+
+                visibilities.resize(end - begin);
+                u.resize(end - begin);
+                v.resize(end - begin);
+                for (size_t pos = begin; pos < end; ++pos) {
+                    size_t k = plane_order[b][pos];
+                    visibilities[pos - begin] = visibilities_batch[b][k];
+                    u[pos - begin] = u_batch[b][k];
+                    v[pos - begin] = v_batch[b][k];
+                }
+
+                gridDirectionScatter(private_grids, visibilities, u, v, uv_max, grid_res, image_size, threads_per_dir);
+                std::vector<std::complex<double>>& grid = private_grids[0];
+                cpuFFTEngine<double>().transform(grid.data(), image_size, true, threads_per_dir);
+
+                const double w_plane = layouts[b].planeCenter(p);
+                std::complex<double>* accumulator = accumulators[b].data();
+                parallelFor(num_pixels, threads_per_dir, [&](size_t pixel_begin, size_t pixel_end, size_t) {
+                    for (size_t i = pixel_begin; i < pixel_end; ++i) {
+                        accumulator[i] += grid[i] * std::polar(1.0, 2 * M_PI * w_plane * screen[i]);
+                    }
+                });
+            }
+        });
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        plane_timings.push_back({p, plane_visibilities,
+                                 std::chrono::duration<double, std::milli>(stop - start).count()});
+    }
+
+    parallelFor(num_batches, threads, [&](size_t dir_begin, size_t dir_end, size_t) {
+        for (size_t b = dir_begin; b < dir_end; ++b) {
+            images[b].resize(num_pixels);
+            cpuFFTEngine<double>().extractImage(accumulators[b].data(), image_size, images[b].data());
+        }
+    });
+}
+
+/**
+ * @brief Generate uniform images from a visibility stream, one block at a time.
+ *
+ * The grids of all directions stay resident and every block is added to the grid of
+ * its direction: the block is split across threads that grid into private grids,
+ * and the private grids are then summed into the direction's grid with a parallel
+ * reduction. While a block is gridded the stream reads the next one.
+ *
+ * @param stream Started visibility stream.
+ * @param image_size Size of the output image.
+ * @param max_uv Maximum UV distance used to size the grid.
+ * @param images Output images.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+void streamImage(VisibilityStream& stream, int image_size, double max_uv,
+                 std::vector<std::vector<double>>& images, unsigned num_threads) {
+    const int num_batches = stream.numDirections();
+    images.resize(num_batches);
+    if (num_batches == 0) return;
+
+    double uv_max, grid_res;
+    gridParameters(max_uv, image_size, uv_max, grid_res);
+
+    const size_t num_cells = static_cast<size_t>(image_size) * image_size;
+    const unsigned threads = resolveThreadCount(num_threads);
+    std::vector<std::complex<double>> grids(num_batches * num_cells, std::complex<double>(0, 0));
+    std::vector<std::vector<std::complex<double>>> private_grids;
+
+    for (const VisibilityBlock* block = stream.next(); block; block = stream.next()) {
+        const size_t min_block = 16384;
+        size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, block->count / min_block));
+        private_grids.resize(std::max(private_grids.size(), chunks));
+
+        parallelFor(chunks, threads, [&](size_t chunk_begin, size_t chunk_end, size_t) {
+            for (size_t c = chunk_begin; c < chunk_end; ++c) {
+                private_grids[c].assign(num_cells, std::complex<double>(0, 0));
+                size_t begin = c * block->count / chunks;
+                size_t end = (c + 1) * block->count / chunks;
+                gridRange(private_grids[c].data(), block->visibilities.data(), block->u.data(), block->v.data(),
+                          begin, end, uv_max, grid_res, image_size);
+            }
+        });
+
+        std::complex<double>* grid = grids.data() + block->direction * num_cells;
+        parallelFor(num_cells, threads, [&](size_t cell_begin, size_t cell_end, size_t) {
+            for (size_t c = 0; c < chunks; ++c) {
+                const std::complex<double>* src = private_grids[c].data();
+                for (size_t cell = cell_begin; cell < cell_end; ++cell) {
+                    grid[cell] += src[cell];
+                }
+            }
+        });
+    }
+
+    cpuFFTEngine<double>().toImages(grids, num_batches, image_size, images, num_threads);
+}
+
+}
+
+/**
+ * @brief ImagingBackend implementation backed by the native CPU engine.
+ */
+class CpuBackend : public ImagingBackend {
+public:
+    explicit CpuBackend(unsigned num_threads) : num_threads_(num_threads) {}
+
+    const char* name() const override { return "cpu"; }
+
+    void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                    const std::vector<double>& HAs, const std::vector<double>& Decs,
+                    std::vector<std::vector<double>>& u, std::vector<std::vector<double>>& v, std::vector<std::vector<double>>& w) override {
+        cpu::computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w, num_threads_);
+    }
+
+    void computeUVW(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                    const std::vector<double>& HAs, const std::vector<double>& Decs,
+                    std::vector<std::vector<float>>& u, std::vector<std::vector<float>>& v, std::vector<std::vector<float>>& w) override {
+        cpu::computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w, num_threads_);
+    }
+
+    void uniformImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                      const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                      int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                      GridderMode gridder) override {
+        cpu::uniformImage(visibilities_batch, u_batch, v_batch, image_size, images, use_predefined_params, gridder, num_threads_);
+    }
+
+    void uniformImage(const std::vector<std::vector<std::complex<float>>>& visibilities_batch,
+                      const std::vector<std::vector<float>>& u_batch, const std::vector<std::vector<float>>& v_batch,
+                      int image_size, std::vector<std::vector<float>>& images, bool use_predefined_params,
+                      GridderMode gridder) override {
+        cpu::uniformImage(visibilities_batch, u_batch, v_batch, image_size, images, use_predefined_params, gridder, num_threads_);
+    }
+
+    void uniformImage(const std::vector<std::vector<std::complex<float>>>& visibilities_batch,
+                      const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                      int image_size, std::vector<std::vector<float>>& images, bool use_predefined_params,
+                      GridderMode gridder) override {
+        cpu::uniformImage(visibilities_batch, u_batch, v_batch, image_size, images, use_predefined_params, gridder, num_threads_);
+    }
+
+    void planImage(const GriddingPlan& plan, const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                   std::vector<std::vector<double>>& images) override {
+        cpu::planImage(plan, visibilities_batch, images, num_threads_);
+    }
+
+    void wStackImage(const std::vector<std::vector<std::complex<double>>>& visibilities_batch,
+                     const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                     const std::vector<std::vector<double>>& w_batch,
+                     int image_size, std::vector<std::vector<double>>& images, bool use_predefined_params,
+                     int num_w_planes, std::vector<WPlaneTiming>& plane_timings) override {
+        cpu::wStackImage(visibilities_batch, u_batch, v_batch, w_batch, image_size, images, use_predefined_params,
+                         num_w_planes, plane_timings, num_threads_);
+    }
+
+    void streamImage(VisibilityStream& stream, int image_size, double max_uv,
+                     std::vector<std::vector<double>>& images) override {
+        cpu::streamImage(stream, image_size, max_uv, images, num_threads_);
+    }
+
+private:
+    unsigned num_threads_;
+};
+
+/**
+ * @brief Create the native CPU imaging backend.
+ *
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ * @return std::unique_ptr<ImagingBackend> The CPU backend.
+ */
+std::unique_ptr<ImagingBackend> makeCpuBackend(unsigned num_threads) {
+    return std::make_unique<CpuBackend>(num_threads);
+}
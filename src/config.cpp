@@ -8,6 +8,7 @@
 namespace config {
     int IMAGE_SIZE;
     double PREDEFINED_MAX_UV;
+    std::string PRECISION = "double";
 
     /**
      * @brief Loads the configuration settings from a JSON file.
@@ -21,5 +22,6 @@ namespace config {
 
         IMAGE_SIZE = config_json["IMAGE_SIZE"];
         PREDEFINED_MAX_UV = config_json["PREDEFINED_MAX_UV"];
+        PRECISION = config_json.value("PRECISION", std::string("double"));
     }
 }
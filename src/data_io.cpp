@@ -1,11 +1,88 @@
 #include "data_io.hpp"
+#include "mapped_file.hpp"
+#include <charconv>
+#include <cstring>
 #include <fstream>
-#include <sstream>
 #include <iostream>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+/**
+ * @brief Parse the CSV fields of one line into values.
+ *
+ * Fields are separated by commas and may be surrounded by spaces or tabs; fields
+ * after the first values.size() are ignored.
+ *
+ * @param begin Start of the line.
+ * @param end End of the line (excluding the newline).
+ * @param values Output values; its size is the number of fields to parse.
+ * @return true if all fields were parsed.
+ */
+bool parseCsvLine(const char* begin, const char* end, std::vector<double>& values) {
+    const char* p = begin;
+    for (size_t f = 0; f < values.size(); ++f) {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        if (p < end && *p == '+') ++p;
+        auto result = std::from_chars(p, end, values[f]);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        p = result.ptr;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        if (f + 1 < values.size()) {
+            if (p >= end || *p != ',') {
+                return false;
+            }
+            ++p;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Map a CSV file and parse every non-blank line into num_fields values.
+ *
+ * @param filename The path to the CSV file.
+ * @param skip_header Skip the first line.
+ * @param num_fields Number of fields to parse per line.
+ * @param columns Output columns (num_fields vectors).
+ */
+void readCsvColumns(const std::string& filename, bool skip_header, size_t num_fields, std::vector<std::vector<double>*> columns) {
+    MappedFile file;
+    if (!file.openRead(filename)) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return;
+    }
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    std::vector<double> values(num_fields);
+    size_t line_number = 0;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* line_end = newline ? newline : end;
+        ++line_number;
+
+        const char* q = p;
+        while (q < line_end && (*q == ' ' || *q == '\t' || *q == '\r')) ++q;
+        if (!(skip_header && line_number == 1) && q < line_end) {
+            if (!parseCsvLine(p, line_end, values)) {
+                std::cerr << "Error parsing line " << line_number << " of file: " << filename << "\n";
+                return;
+            }
+            for (size_t f = 0; f < num_fields; ++f) {
+                columns[f]->push_back(values[f]);
+            }
+        }
+        p = line_end + 1;
+    }
+}
+
+}
+
 /**
  * @brief Reads XYZ coordinates from a CSV file.
  * 
@@ -18,24 +95,7 @@ void readXYZCoordinates(const std::string& filename,
                         std::vector<double>& x_m, 
                         std::vector<double>& y_m, 
                         std::vector<double>& z_m) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << "\n";
-        return;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream ss(line);
-        double x_val, y_val, z_val;
-        char comma;
-
-        ss >> x_val >> comma >> y_val >> comma >> z_val;
-        x_m.push_back(x_val);
-        y_m.push_back(y_val);
-        z_m.push_back(z_val);
-    }
-    file.close();
+    readCsvColumns(filename, false, 3, {&x_m, &y_m, &z_m});
 }
 
 
@@ -47,26 +107,43 @@ void readXYZCoordinates(const std::string& filename,
  * @param w Vector of W coordinates for multiple directions.
  * @param directory The directory to save the UVW coordinate files.
  */
-void saveUVWCoordinates(const std::vector<std::vector<double>>& u, const std::vector<std::vector<double>>& v, const std::vector<std::vector<double>>& w, const std::string& directory) {
+template <typename Real>
+void saveUVWCoordinates(const std::vector<std::vector<Real>>& u, const std::vector<std::vector<Real>>& v, const std::vector<std::vector<Real>>& w, const std::string& directory) {
     fs::create_directories(directory);
     int total_directions = u.size();
     for (size_t d = 0; d < u.size(); ++d) {
-        std::ofstream uvwfile(directory + "/uvw_coordinates_" + std::to_string(d) + ".csv");
-        if (uvwfile.is_open()) {
-            uvwfile << "u,v,w\n";
-            for (size_t i = 0; i < u[d].size(); ++i) {
-                uvwfile << u[d][i] << "," << v[d][i] << "," << w[d][i] << "\n";
-            }
-            uvwfile.close();
+        if (saveUVWCoordinatesCSV(u[d], v[d], w[d], directory, d)) {
             if (d % 10 == 0 || d == u.size() - 1) { // Print progress every 10 directions
                 std::cout << "UVW Progress: " << ((d + 1) * 100 / total_directions) << "% (" << (d + 1) << "/" << total_directions << " directions saved)\n";
             }
-        } else {
-            std::cerr << "Error opening file for writing UVW coordinates.\n";
         }
     }
 }
 
+/**
+ * @brief Saves the UVW coordinates of one direction to uvw_coordinates_<direction>.csv.
+ * 
+ * @param u U coordinates of the direction.
+ * @param v V coordinates of the direction.
+ * @param w W coordinates of the direction.
+ * @param directory The directory to save the file (must exist).
+ * @param direction Index of the direction.
+ * @return true if the file was written.
+ */
+template <typename Real>
+bool saveUVWCoordinatesCSV(const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w, const std::string& directory, size_t direction) {
+    std::ofstream uvwfile(directory + "/uvw_coordinates_" + std::to_string(direction) + ".csv");
+    if (!uvwfile.is_open()) {
+        std::cerr << "Error opening file for writing UVW coordinates.\n";
+        return false;
+    }
+    uvwfile << "u,v,w\n";
+    for (size_t i = 0; i < u.size(); ++i) {
+        uvwfile << u[i] << "," << v[i] << "," << w[i] << "\n";
+    }
+    return true;
+}
+
 /**
  * @brief Saves images to CSV files in the specified directory.
  * 
@@ -74,32 +151,56 @@ void saveUVWCoordinates(const std::vector<std::vector<double>>& u, const std::ve
  * @param image_size Size of the images.
  * @param directory The directory to save the image files.
  */
-void saveImages(const std::vector<std::vector<double>>& images, int image_size, const std::string& directory) {
+template <typename Real>
+void saveImages(const std::vector<std::vector<Real>>& images, int image_size, const std::string& directory) {
     fs::create_directories(directory);
     int total_images = images.size();
     for (size_t d = 0; d < images.size(); ++d) {
-        std::ofstream outfile(directory + "/image_data_gpu_" + std::to_string(d) + ".csv");
-        if (outfile.is_open()) {
-            for (int i = 0; i < image_size; ++i) {
-                for (int j = 0; j < image_size; ++j) {
-                    int index = i * image_size + j;
-                    outfile << images[d][index];
-                    if (j < image_size - 1) {
-                        outfile << ",";
-                    }
-                }
-                outfile << "\n";
-            }
-            outfile.close();
+        if (saveImageCSV(images[d], image_size, directory, d)) {
             if (d % 10 == 0 || d == images.size() - 1) { // Print progress every 10 images
                 std::cout << "Progress: " << ((d + 1) * 100 / total_images) << "% (" << (d + 1) << "/" << total_images << " images saved)\n";
             }
-        } else {
-            std::cerr << "Error opening file for writing images.\n";
         }
     }
 }
 
+/**
+ * @brief Saves one image to image_data_gpu_<index>.csv.
+ * 
+ * @param image The image (image_size x image_size, row-major).
+ * @param image_size Size of the image.
+ * @param directory The directory to save the file (must exist).
+ * @param index Index of the image.
+ * @return true if the file was written.
+ */
+template <typename Real>
+bool saveImageCSV(const std::vector<Real>& image, int image_size, const std::string& directory, size_t index) {
+    std::ofstream outfile(directory + "/image_data_gpu_" + std::to_string(index) + ".csv");
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening file for writing images.\n";
+        return false;
+    }
+    for (int i = 0; i < image_size; ++i) {
+        for (int j = 0; j < image_size; ++j) {
+            outfile << image[i * image_size + j];
+            if (j < image_size - 1) {
+                outfile << ",";
+            }
+        }
+        outfile << "\n";
+    }
+    return true;
+}
+
+template void saveUVWCoordinates<float>(const std::vector<std::vector<float>>&, const std::vector<std::vector<float>>&, const std::vector<std::vector<float>>&, const std::string&);
+template void saveUVWCoordinates<double>(const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&, const std::string&);
+template void saveImages<float>(const std::vector<std::vector<float>>&, int, const std::string&);
+template void saveImages<double>(const std::vector<std::vector<double>>&, int, const std::string&);
+template bool saveUVWCoordinatesCSV<float>(const std::vector<float>&, const std::vector<float>&, const std::vector<float>&, const std::string&, size_t);
+template bool saveUVWCoordinatesCSV<double>(const std::vector<double>&, const std::vector<double>&, const std::vector<double>&, const std::string&, size_t);
+template bool saveImageCSV<float>(const std::vector<float>&, int, const std::string&, size_t);
+template bool saveImageCSV<double>(const std::vector<double>&, int, const std::string&, size_t);
+
 /**
  * @brief Reads HAs and Decs from a CSV file.
  * 
@@ -108,21 +209,5 @@ void saveImages(const std::vector<std::vector<double>>& images, int image_size,
  * @param Decs Vector to store the Declinations.
  */
 void readDirections(const std::string& filename, std::vector<double>& HAs, std::vector<double>& Decs) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return;
-    }
-
-    std::string line;
-    std::getline(file, line); // Skip header
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string ha_str, dec_str;
-        std::getline(ss, ha_str, ',');
-        std::getline(ss, dec_str, ',');
-        HAs.push_back(std::stod(ha_str));
-        Decs.push_back(std::stod(dec_str));
-    }
-    file.close();
+    readCsvColumns(filename, true, 2, {&HAs, &Decs}); // Skip header
 }
@@ -0,0 +1,280 @@
+#include "fft_engine.hpp"
+#include "gridding.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+bool isPowerOfTwo(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+}
+
+/**
+ * @brief Precomputed tables for a 1D complex FFT of a fixed length and direction.
+ *
+ * Power-of-two lengths use an iterative radix-2 transform. Any other length is
+ * handled with Bluestein's algorithm on top of a power-of-two transform, so the
+ * engine accepts every IMAGE_SIZE that the CUDA path accepts.
+ */
+template <typename Real>
+struct Fft1dPlan {
+    using Complex = std::complex<Real>;
+
+    int n = 0;
+    bool inverse = false;
+    std::vector<Complex> twiddles;          // radix-2 twiddles, n/2 entries
+    std::vector<int> bit_reverse;           // radix-2 permutation, n entries
+
+    // Bluestein state (only used when n is not a power of two)
+    int m = 0;
+    std::vector<Complex> chirp;             // exp(sign * i*pi*k^2/n), n entries
+    std::vector<Complex> kernel_fft;        // forward FFT of the conjugate chirp, m entries
+    std::vector<Fft1dPlan> sub_plans;       // forward and inverse plans of length m
+
+    Fft1dPlan() = default;
+    Fft1dPlan(int length, bool inverse_transform);
+
+    void execute(Complex* data, std::vector<Complex>& scratch) const;
+
+private:
+    void radix2(Complex* data) const;
+};
+
+// Tables are always computed in double precision and rounded once to Real
+template <typename Real>
+Fft1dPlan<Real>::Fft1dPlan(int length, bool inverse_transform) : n(length), inverse(inverse_transform) {
+    const double sign = inverse ? 1.0 : -1.0;
+
+    if (isPowerOfTwo(n)) {
+        twiddles.resize(n / 2);
+        for (int k = 0; k < n / 2; ++k) {
+            double angle = sign * 2.0 * M_PI * k / n;
+            twiddles[k] = Complex(static_cast<Real>(std::cos(angle)), static_cast<Real>(std::sin(angle)));
+        }
+
+        bit_reverse.resize(n);
+        int bits = 0;
+        while ((1 << bits) < n) ++bits;
+        for (int i = 0; i < n; ++i) {
+            int r = 0;
+            for (int b = 0; b < bits; ++b) {
+                if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+            }
+            bit_reverse[i] = r;
+        }
+        return;
+    }
+
+    m = 1;
+    while (m < 2 * n - 1) m <<= 1;
+
+    chirp.resize(n);
+    for (int k = 0; k < n; ++k) {
+        // Reduce k^2 modulo 2n before scaling to keep the angle accurate for large k
+        long long k2 = (static_cast<long long>(k) * k) % (2LL * n);
+        double angle = sign * M_PI * static_cast<double>(k2) / n;
+        chirp[k] = Complex(static_cast<Real>(std::cos(angle)), static_cast<Real>(std::sin(angle)));
+    }
+
+    sub_plans.emplace_back(m, false);
+    sub_plans.emplace_back(m, true);
+
+    kernel_fft.assign(m, Complex(0, 0));
+    kernel_fft[0] = std::conj(chirp[0]);
+    for (int k = 1; k < n; ++k) {
+        kernel_fft[k] = std::conj(chirp[k]);
+        kernel_fft[m - k] = std::conj(chirp[k]);
+    }
+    std::vector<Complex> unused;
+    sub_plans[0].execute(kernel_fft.data(), unused);
+}
+
+template <typename Real>
+void Fft1dPlan<Real>::radix2(Complex* data) const {
+    for (int i = 0; i < n; ++i) {
+        int r = bit_reverse[i];
+        if (i < r) std::swap(data[i], data[r]);
+    }
+
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        int step = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int k = 0; k < half; ++k) {
+                Complex t = twiddles[k * step] * data[start + k + half];
+                Complex a = data[start + k];
+                data[start + k] = a + t;
+                data[start + k + half] = a - t;
+            }
+        }
+    }
+}
+
+template <typename Real>
+void Fft1dPlan<Real>::execute(Complex* data, std::vector<Complex>& scratch) const {
+    if (m == 0) {
+        radix2(data);
+        return;
+    }
+
+    scratch.assign(m, Complex(0, 0));
+    for (int k = 0; k < n; ++k) {
+        scratch[k] = data[k] * chirp[k];
+    }
+
+    std::vector<Complex> unused;
+    sub_plans[0].execute(scratch.data(), unused);
+    for (int k = 0; k < m; ++k) {
+        scratch[k] *= kernel_fft[k];
+    }
+    sub_plans[1].execute(scratch.data(), unused);
+
+    const Real scale = Real(1) / m;
+    for (int k = 0; k < n; ++k) {
+        data[k] = chirp[k] * scratch[k] * scale;
+    }
+}
+
+/**
+ * @brief Get the cached 1D plan for a length and direction, building it on first use.
+ *
+ * @param length Transform length.
+ * @param inverse Inverse (positive exponent) transform if true.
+ * @return std::shared_ptr<const Fft1dPlan<Real>> The cached plan.
+ */
+template <typename Real>
+std::shared_ptr<const Fft1dPlan<Real>> CpuFFTEngine<Real>::planFor(int length, bool inverse) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& plan = plans_[std::make_pair(length, inverse)];
+    if (!plan) {
+        plan = std::make_shared<const Fft1dPlan<Real>>(length, inverse);
+    }
+    return plan;
+}
+
+/**
+ * @brief Drop all cached plans.
+ */
+template <typename Real>
+void CpuFFTEngine<Real>::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    plans_.clear();
+}
+
+/**
+ * @brief Unnormalized in-place 2D complex FFT (same convention as cuFFT Z2Z).
+ *
+ * @param grid Row-major data of size image_size * image_size.
+ * @param image_size Size of the grid.
+ * @param inverse Compute the inverse (positive exponent) transform if true.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+template <typename Real>
+void CpuFFTEngine<Real>::transform(std::complex<Real>* grid, int image_size, bool inverse, unsigned num_threads) {
+    std::shared_ptr<const Fft1dPlan<Real>> plan = planFor(image_size, inverse);
+    const size_t n = image_size;
+
+    parallelFor(n, num_threads, [&](size_t begin, size_t end, size_t) {
+        std::vector<std::complex<Real>> scratch;
+        for (size_t y = begin; y < end; ++y) {
+            plan->execute(grid + y * n, scratch);
+        }
+    });
+
+    parallelFor(n, num_threads, [&](size_t begin, size_t end, size_t) {
+        std::vector<std::complex<Real>> column(n);
+        std::vector<std::complex<Real>> scratch;
+        for (size_t x = begin; x < end; ++x) {
+            for (size_t y = 0; y < n; ++y) column[y] = grid[y * n + x];
+            plan->execute(column.data(), scratch);
+            for (size_t y = 0; y < n; ++y) grid[y * n + x] = column[y];
+        }
+    });
+}
+
+/**
+ * @brief Turn one gridded direction into a normalized real image.
+ *
+ * @param grid Gridded visibilities in FFT-engine layout (transformed in place).
+ * @param image_size Size of the image.
+ * @param image Output image (image_size * image_size values).
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+template <typename Real>
+void CpuFFTEngine<Real>::toImage(std::complex<Real>* grid, int image_size, Real* image, unsigned num_threads) {
+    transform(grid, image_size, true, num_threads);
+    extractImage(grid, image_size, image);
+}
+
+/**
+ * @brief Extract the normalized real image from an inverse-transformed grid.
+ *
+ * The final fftshift is folded into the read index (see imageSourceIndex).
+ *
+ * @param grid Inverse-transformed grid.
+ * @param image_size Size of the image.
+ * @param image Output image, image_size^2 values.
+ */
+template <typename Real>
+void CpuFFTEngine<Real>::extractImage(const std::complex<Real>* grid, int image_size, Real* image) {
+    Real max_value = 0;
+    for (int k = 0; k < image_size; ++k) {
+        for (int l = 0; l < image_size; ++l) {
+            Real value = static_cast<Real>(imageSourceSign(k, l, image_size)) * grid[imageSourceIndex(k, l, image_size)].real();
+            image[static_cast<size_t>(k) * image_size + l] = value;
+            max_value = std::max(max_value, std::abs(value));
+        }
+    }
+
+    const size_t num_pixels = static_cast<size_t>(image_size) * image_size;
+    for (size_t i = 0; i < num_pixels; ++i) {
+        image[i] /= max_value;
+    }
+}
+
+/**
+ * @brief Turn a batch of gridded directions into normalized real images.
+ *
+ * @param grids Gridded visibilities of all directions, one image_size^2 block per direction (transformed in place).
+ * @param num_directions Number of directions.
+ * @param image_size Size of the images.
+ * @param images Output images.
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+template <typename Real>
+void CpuFFTEngine<Real>::toImages(std::vector<std::complex<Real>>& grids, int num_directions, int image_size,
+                                  std::vector<std::vector<Real>>& images, unsigned num_threads) {
+    const size_t num_pixels = static_cast<size_t>(image_size) * image_size;
+    images.resize(num_directions);
+
+    unsigned threads = resolveThreadCount(num_threads);
+    unsigned dir_workers = std::min<unsigned>(threads, std::max(num_directions, 1));
+    unsigned threads_per_dir = std::max(1u, threads / dir_workers);
+
+    parallelFor(num_directions, dir_workers, [&](size_t begin, size_t end, size_t) {
+        for (size_t d = begin; d < end; ++d) {
+            images[d].resize(num_pixels);
+            toImage(grids.data() + d * num_pixels, image_size, images[d].data(), threads_per_dir);
+        }
+    });
+}
+
+template class CpuFFTEngine<float>;
+template class CpuFFTEngine<double>;
+
+/**
+ * @brief Process-wide CPU FFT engine of a precision, shared so that plans are reused across calls.
+ *
+ * @return CpuFFTEngine<Real>& The engine.
+ */
+template <typename Real>
+CpuFFTEngine<Real>& cpuFFTEngine() {
+    static CpuFFTEngine<Real> engine;
+    return engine;
+}
+
+template CpuFFTEngine<float>& cpuFFTEngine<float>();
+template CpuFFTEngine<double>& cpuFFTEngine<double>();
@@ -0,0 +1,215 @@
+#include "gridding_plan.hpp"
+#include "gridding.hpp"
+#include "compute_cpu.hpp"
+#include "parallel.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+
+const char PLAN_MAGIC[4] = {'R', 'I', 'G', 'P'};
+const std::uint32_t PLAN_VERSION = 1;
+
+/**
+ * @brief Incremental 64-bit FNV-1a hash.
+ */
+struct Fnv1a {
+    std::uint64_t state = 1469598103934665603ULL;
+
+    void add(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            state ^= bytes[i];
+            state *= 1099511628211ULL;
+        }
+    }
+
+    template <typename T>
+    void addValue(const T& value) {
+        add(&value, sizeof(T));
+    }
+
+    void addVector(const std::vector<double>& values) {
+        addValue(static_cast<std::uint64_t>(values.size()));
+        add(values.data(), values.size() * sizeof(double));
+    }
+};
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+}
+
+/**
+ * @brief Compute the cache key of a plan from everything that determines the uv -> cell mapping.
+ *
+ * @param x_m X coordinates of the antennas.
+ * @param y_m Y coordinates of the antennas.
+ * @param z_m Z coordinates of the antennas.
+ * @param HAs Hour angles for multiple directions.
+ * @param Decs Declinations for multiple directions.
+ * @param image_size Size of the output image.
+ * @param use_predefined_params Flag to determine if predefined parameters are used.
+ * @param predefined_max_uv PREDEFINED_MAX_UV (only part of the key if use_predefined_params is set).
+ * @return std::uint64_t The plan key.
+ */
+std::uint64_t GriddingPlan::computeKey(const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                                       const std::vector<double>& HAs, const std::vector<double>& Decs,
+                                       int image_size, bool use_predefined_params, double predefined_max_uv) {
+    Fnv1a hash;
+    hash.addValue(PLAN_VERSION);
+    hash.addVector(x_m);
+    hash.addVector(y_m);
+    hash.addVector(z_m);
+    hash.addVector(HAs);
+    hash.addVector(Decs);
+    hash.addValue(image_size);
+    hash.addValue(static_cast<std::uint8_t>(use_predefined_params));
+    if (use_predefined_params) {
+        hash.addValue(predefined_max_uv);
+    }
+    return hash.state;
+}
+
+/**
+ * @brief Path of the cached plan file for a key inside a cache directory.
+ *
+ * @param directory The plan cache directory.
+ * @param key The plan key.
+ * @return std::string Path of the plan file.
+ */
+std::string GriddingPlan::cachePath(const std::string& directory, std::uint64_t key) {
+    std::ostringstream name;
+    name << directory << "/gridding_plan_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return name.str();
+}
+
+/**
+ * @brief Build the plan from UVW coordinates by counting-sorting baselines by grid cell.
+ *
+ * @param u_batch U coordinates for multiple directions.
+ * @param v_batch V coordinates for multiple directions.
+ * @param image_size Size of the output image.
+ * @param max_uv Maximum UV distance used to size the grid.
+ * @param key The plan key (see computeKey).
+ * @param num_threads Number of worker threads (0 = all hardware threads).
+ */
+void GriddingPlan::build(const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                         int image_size, double max_uv, std::uint64_t key, unsigned num_threads) {
+    key_ = key;
+    image_size_ = image_size;
+    num_baselines_ = u_batch.empty() ? 0 : u_batch[0].size();
+
+    if (num_baselines_ > std::numeric_limits<std::uint32_t>::max()) {
+        std::cerr << "Error: Too many baselines for a gridding plan (" << num_baselines_ << ").\n";
+        exit(EXIT_FAILURE);
+    }
+
+    double uv_max, grid_res;
+    gridParameters(max_uv, image_size, uv_max, grid_res);
+
+    const int num_directions = u_batch.size();
+    const int num_cells = image_size * image_size;
+    cell_offsets_.assign(num_directions, {});
+    baseline_indices_.assign(num_directions, {});
+
+    std::vector<int> cells(num_baselines_);
+    std::vector<size_t> offsets;
+    std::vector<size_t> order;
+    for (int d = 0; d < num_directions; ++d) {
+        const double* u = u_batch[d].data();
+        const double* v = v_batch[d].data();
+        parallelFor(num_baselines_, num_threads, [&](size_t begin, size_t end, size_t) {
+            for (size_t k = begin; k < end; ++k) {
+                cells[k] = gridCellIndex(u[k], v[k], uv_max, grid_res, image_size);
+            }
+        });
+
+        cpu::countingSort(cells, num_cells, num_threads, offsets, order);
+        cell_offsets_[d].assign(offsets.begin(), offsets.end());
+        baseline_indices_[d].assign(order.begin(), order.end());
+    }
+}
+
+/**
+ * @brief Load a plan from disk.
+ *
+ * @param filename Path of the plan file.
+ * @param expected_key Key the plan must have; a plan with any other key is rejected.
+ * @return true if the plan was loaded.
+ */
+bool GriddingPlan::load(const std::string& filename, std::uint64_t expected_key) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key, num_baselines;
+    std::int32_t image_size, num_directions;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, PLAN_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(file, version) || version != PLAN_VERSION ||
+        !readValue(file, key) || key != expected_key ||
+        !readValue(file, image_size) || !readValue(file, num_directions) || !readValue(file, num_baselines)) {
+        std::cerr << "Ignoring incompatible gridding plan: " << filename << "\n";
+        return false;
+    }
+
+    const size_t num_cells = static_cast<size_t>(image_size) * image_size;
+    std::vector<std::vector<std::uint32_t>> cell_offsets(num_directions, std::vector<std::uint32_t>(num_cells + 1));
+    std::vector<std::vector<std::uint32_t>> baseline_indices(num_directions);
+    for (int d = 0; d < num_directions; ++d) {
+        file.read(reinterpret_cast<char*>(cell_offsets[d].data()), cell_offsets[d].size() * sizeof(std::uint32_t));
+        baseline_indices[d].resize(cell_offsets[d].back());
+        file.read(reinterpret_cast<char*>(baseline_indices[d].data()), baseline_indices[d].size() * sizeof(std::uint32_t));
+        if (!file) {
+            std::cerr << "Error reading gridding plan: " << filename << "\n";
+            return false;
+        }
+    }
+
+    key_ = key;
+    image_size_ = image_size;
+    num_baselines_ = num_baselines;
+    cell_offsets_.swap(cell_offsets);
+    baseline_indices_.swap(baseline_indices);
+    return true;
+}
+
+/**
+ * @brief Save the plan to disk.
+ *
+ * @param filename Path of the plan file.
+ * @return true if the plan was written.
+ */
+bool GriddingPlan::save(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file for writing gridding plan: " << filename << "\n";
+        return false;
+    }
+
+    file.write(PLAN_MAGIC, sizeof(PLAN_MAGIC));
+    writeValue(file, PLAN_VERSION);
+    writeValue(file, key_);
+    writeValue(file, static_cast<std::int32_t>(image_size_));
+    writeValue(file, static_cast<std::int32_t>(numDirections()));
+    writeValue(file, static_cast<std::uint64_t>(num_baselines_));
+    for (int d = 0; d < numDirections(); ++d) {
+        file.write(reinterpret_cast<const char*>(cell_offsets_[d].data()), cell_offsets_[d].size() * sizeof(std::uint32_t));
+        file.write(reinterpret_cast<const char*>(baseline_indices_[d].data()), baseline_indices_[d].size() * sizeof(std::uint32_t));
+    }
+    return static_cast<bool>(file);
+}
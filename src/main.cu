@@ -1,7 +1,13 @@
 // src/main.cu
 #include "config.hpp"
-#include "compute.hpp"
+#include "backend.hpp"
 #include "data_io.hpp"
+#include "gridding_plan.hpp"
+#include "precision.hpp"
+#include "output_writer.hpp"
+#include "async_writer.hpp"
+#include "visibility_io.hpp"
+#include "server.hpp"
 #include <iostream>
 #include <vector>
 #include <complex>
@@ -9,10 +15,265 @@
 #include <fstream>
 #include <cmath>  // For M_PI
 #include <filesystem>  // For creating directories
+#include <memory>
+#include <algorithm>
+#include <sys/resource.h>
 #include <argparse/argparse.hpp>
 
 namespace fs = std::filesystem;
 
+/**
+ * @brief Where and in which format the results are saved.
+ */
+struct OutputOptions {
+    bool output_uvw;
+    std::string uvw_dir;
+    bool save_images;
+    std::string image_dir;
+    OutputFormat format;
+};
+
+/**
+ * @brief Queue the UVW coordinates of all directions on the writer thread.
+ *
+ * The coordinates are written in place, so u, v and w must stay alive until the writer finishes.
+ *
+ * @param writer The background writer.
+ * @param uvw_writer The UVW output (opened).
+ * @param u U coordinates for multiple directions.
+ * @param v V coordinates for multiple directions.
+ * @param w W coordinates for multiple directions.
+ */
+template <typename Real>
+void queueUVW(AsyncWriter& writer, UVWWriter<Real>& uvw_writer,
+              const std::vector<std::vector<Real>>& u, const std::vector<std::vector<Real>>& v, const std::vector<std::vector<Real>>& w) {
+    // A single task, so that queueing never waits for the UVW output and the imaging starts at once
+    writer.submit([&uvw_writer, &u, &v, &w]() {
+        for (size_t d = 0; d < u.size(); ++d) {
+            uvw_writer.write(d, u[d], v[d], w[d]);
+        }
+    });
+}
+
+/**
+ * @brief Queue a batch of finished images on the writer thread.
+ *
+ * @param writer The background writer.
+ * @param image_writer The image output (opened).
+ * @param images Images of the batch (owned by the queued task until it is written).
+ * @param first_index Index of the first image of the batch.
+ */
+template <typename Real>
+void queueImages(AsyncWriter& writer, ImageWriter<Real>& image_writer,
+                 std::shared_ptr<std::vector<std::vector<Real>>> images, size_t first_index) {
+    writer.submit([&image_writer, images, first_index]() {
+        for (size_t d = 0; d < images->size(); ++d) {
+            image_writer.write(first_index + d, (*images)[d]);
+        }
+    });
+}
+
+/**
+ * @brief Image all directions with uniformImage, image_batch directions per call.
+ *
+ * Every finished batch is queued on the writer thread, so it is written while the
+ * next batch is imaged.
+ *
+ * @param backend The imaging backend.
+ * @param u U coordinates for multiple directions.
+ * @param v V coordinates for multiple directions.
+ * @param image_size Size of the output image.
+ * @param use_predefined_params Flag to determine if predefined parameters are used.
+ * @param gridder Gridding strategy.
+ * @param image_batch Number of directions per imaging call (0 = all).
+ * @param writer The background writer.
+ * @param image_writer The image output, or nullptr if images are not saved.
+ */
+template <typename UVWReal, typename GridReal>
+void imageInBatches(ImagingBackend& backend, const std::vector<std::vector<UVWReal>>& u, const std::vector<std::vector<UVWReal>>& v,
+                    int image_size, bool use_predefined_params, GridderMode gridder, size_t image_batch,
+                    AsyncWriter& writer, ImageWriter<GridReal>* image_writer) {
+    const size_t num_directions = u.size();
+    const size_t batch = (image_batch > 0 && image_batch < num_directions) ? image_batch : num_directions;
+    std::vector<std::vector<UVWReal>> u_part, v_part;
+    for (size_t first = 0; first < num_directions; first += batch) {
+        const size_t count = std::min(batch, num_directions - first);
+        const std::vector<std::vector<UVWReal>>* u_batch = &u;
+        const std::vector<std::vector<UVWReal>>* v_batch = &v;
+        if (count < num_directions) {
+            u_part.assign(u.begin() + first, u.begin() + first + count);
+            v_part.assign(v.begin() + first, v.begin() + first + count);
+            u_batch = &u_part;
+            v_batch = &v_part;
+        }
+
+        std::vector<std::vector<std::complex<GridReal>>> visibilities(count, std::vector<std::complex<GridReal>>(u[0].size(), std::complex<GridReal>(1, 0)));
+        auto images = std::make_shared<std::vector<std::vector<GridReal>>>();
+        backend.uniformImage(visibilities, *u_batch, *v_batch, image_size, *images, use_predefined_params, gridder);
+        if (image_writer) {
+            queueImages(writer, *image_writer, images, first);
+        }
+    }
+}
+
+/**
+ * @brief Wait for the writer thread and report the time spent on output.
+ *
+ * @param writer The background writer.
+ */
+void finishOutput(AsyncWriter& writer) {
+    auto start = std::chrono::high_resolution_clock::now();
+    writer.finish();
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    std::cout << "Output written. Writer time: " << static_cast<long long>(writer.busyMilliseconds())
+              << " ms, waited after imaging: " << waited.count() << " ms\n";
+}
+
+/**
+ * @brief Print the peak resident memory of the process.
+ */
+void reportPeakMemory() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // ru_maxrss is in kilobytes on Linux
+        std::cout << "Peak resident memory: " << usage.ru_maxrss / 1024 << " MB\n";
+    }
+}
+
+/**
+ * @brief Image a binary visibility file block by block within a memory budget.
+ *
+ * The budget is spent on the grids and images of all directions first; the rest
+ * sizes the two stream blocks and the read buffer (see streamBlockVisibilities).
+ *
+ * @param backend The imaging backend.
+ * @param filename Path of the visibility file.
+ * @param image_size Size of the output image.
+ * @param use_predefined_params Flag to determine if predefined parameters are used.
+ * @param memory_budget_mb Memory budget in MB.
+ * @param output Where and in which format the images are saved.
+ * @return int Exit status of the program.
+ */
+int imageVisibilityFile(ImagingBackend& backend, const std::string& filename, int image_size, bool use_predefined_params,
+                        size_t memory_budget_mb, const OutputOptions& output) {
+    VisibilityStream stream;
+    if (!stream.open(filename)) {
+        return 1;
+    }
+
+    const size_t block_visibilities = streamBlockVisibilities(stream, image_size, memory_budget_mb);
+    if (block_visibilities == 0) {
+        return 1;
+    }
+
+    const double max_uv = (use_predefined_params || stream.numDirections() == 0) ? config::PREDEFINED_MAX_UV : stream.maxU(0);
+    std::cout << "Streaming " << stream.totalVisibilities() << " visibilities of " << stream.numDirections()
+              << " directions in blocks of up to " << block_visibilities << " visibilities\n";
+
+    std::vector<std::vector<double>> images;
+    auto start = std::chrono::high_resolution_clock::now();
+    stream.start(block_visibilities);
+    backend.streamImage(stream, image_size, max_uv, images);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    if (stream.failed()) {
+        return 1;
+    }
+    std::cout << "Imaging complete (" << backend.name() << " backend, " << stream.blocksRead() << " blocks streamed). Execution time: "
+              << duration.count() << " ms, waited for reads: " << static_cast<long long>(stream.consumerWaitMilliseconds()) << " ms\n";
+
+    std::ofstream log_file("output.log", std::ios_base::app);
+    log_file << "Imaging time: " << duration.count() << " ms\n";
+    log_file.close();
+
+    if (output.save_images) {
+        ImageWriter<double> image_writer;
+        if (!image_writer.open(output.format, output.image_dir, images.size(), image_size)) {
+            return 1;
+        }
+        {
+            AsyncWriter writer(OUTPUT_QUEUE_CAPACITY);
+            queueImages(writer, image_writer, std::make_shared<std::vector<std::vector<double>>>(std::move(images)), 0);
+            finishOutput(writer);
+        }
+        image_writer.close();
+    }
+
+    reportPeakMemory();
+    return 0;
+}
+
+/**
+ * @brief Compute UVW coordinates, image and save the results in float or mixed precision.
+ *
+ * Visibilities, grids and images are single precision; UVW coordinates are UVWReal
+ * (float for Precision::Float, double for Precision::Mixed).
+ *
+ * @param backend The imaging backend.
+ * @param x_m X coordinates of the antennas.
+ * @param y_m Y coordinates of the antennas.
+ * @param z_m Z coordinates of the antennas.
+ * @param HAs Hour angles for multiple directions.
+ * @param Decs Declinations for multiple directions.
+ * @param image_size Size of the output image.
+ * @param use_predefined_params Flag to determine if predefined parameters are used.
+ * @param gridder Gridding strategy.
+ * @param image_batch Number of directions per imaging call (0 = all).
+ * @param output Where and in which format the results are saved.
+ * @param precision_name Name of the precision (for the report).
+ * @return true if the outputs could be created.
+ */
+template <typename UVWReal>
+bool imageReducedPrecision(ImagingBackend& backend,
+                           const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m,
+                           const std::vector<double>& HAs, const std::vector<double>& Decs,
+                           int image_size, bool use_predefined_params, GridderMode gridder, size_t image_batch,
+                           const OutputOptions& output, const std::string& precision_name) {
+    std::vector<std::vector<UVWReal>> u, v, w;
+
+    auto start_uvw = std::chrono::high_resolution_clock::now();
+    backend.computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w);
+    auto stop_uvw = std::chrono::high_resolution_clock::now();
+    auto duration_uvw = std::chrono::duration_cast<std::chrono::milliseconds>(stop_uvw - start_uvw);
+    std::cout << "UVW computation complete. Execution time: " << duration_uvw.count() << " ms\n";
+
+    // The writer is declared last so that it finishes before the outputs it writes to are destroyed
+    UVWWriter<UVWReal> uvw_writer;
+    ImageWriter<float> image_writer;
+    AsyncWriter writer(OUTPUT_QUEUE_CAPACITY);
+    if (output.output_uvw) {
+        if (!uvw_writer.open(output.format, output.uvw_dir, u.size(), u[0].size())) {
+            return false;
+        }
+        queueUVW(writer, uvw_writer, u, v, w);
+    }
+    if (output.save_images && !image_writer.open(output.format, output.image_dir, HAs.size(), image_size)) {
+        return false;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    imageInBatches(backend, u, v, image_size, use_predefined_params, gridder, image_batch, writer,
+                   output.save_images ? &image_writer : nullptr);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    std::cout << "Imaging complete (" << backend.name() << " backend, " << precision_name << " precision). Execution time: " << duration.count() << " ms\n";
+
+    std::ofstream log_file("output.log", std::ios_base::app);
+    log_file << "UVW computation time: " << duration_uvw.count() << " ms\n";
+    log_file << "Imaging time: " << duration.count() << " ms\n";
+    log_file.close();
+
+    finishOutput(writer);
+    if (output.output_uvw) {
+        uvw_writer.close();
+    }
+    if (output.save_images) {
+        image_writer.close();
+    }
+    reportPeakMemory();
+    return true;
+}
 
 /**
  * @brief Main function to compute UVW coordinates, perform imaging, and save results.
@@ -54,6 +315,72 @@ int main(int argc, char* argv[]) {
         .default_value(std::string("true"))
         .help("Save images (default: true).");
 
+    program.add_argument("--output_format")
+        .default_value(std::string("csv"))
+        .help("Format of the saved images and UVW coordinates: csv (one file per direction), raw, npy or fits (one memory-mapped cube) (default: csv).");
+
+    program.add_argument("--image_batch")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of directions imaged per batch; finished batches are written while the next one is imaged (default: 0 = all directions in one batch).");
+
+    program.add_argument("--visibilities")
+        .default_value(std::string(""))
+        .help("Binary visibility file to image block by block instead of unit visibilities of --input and --directions (default: disabled).");
+
+    program.add_argument("--memory_budget")
+        .default_value(1024)
+        .scan<'i', int>()
+        .help("Memory budget in MB for --visibilities: grids, images and the streamed blocks (default: 1024).");
+
+    program.add_argument("--export_visibilities")
+        .default_value(std::string(""))
+        .help("Write the UVW coordinates and unit visibilities of --input and --directions as a binary visibility file (default: disabled).");
+
+    program.add_argument("--backend")
+        .default_value(std::string("cuda"))
+        .help("Imaging engine to use: cuda or cpu (default: cuda).");
+
+    program.add_argument("--gridder")
+        .default_value(std::string("scatter"))
+        .help("Gridding strategy: scatter or tiled (atomic-free, binned by uv tile) (default: scatter).");
+
+    program.add_argument("--threads")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of worker threads for the cpu backend (default: 0 = all hardware threads).");
+
+    program.add_argument("--plan_cache")
+        .default_value(std::string(""))
+        .help("Directory of cached gridding plans; reuses the uv -> cell mapping of a known array and direction list (default: disabled).");
+
+    program.add_argument("--wstack")
+        .default_value(std::string("false"))
+        .help("Image with w-stacking to correct the w term of wide fields (default: false).");
+
+    program.add_argument("--w_planes")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of w-planes for --wstack (default: 0 = chosen from the w range and field of view).");
+
+    program.add_argument("--precision")
+        .default_value(std::string(""))
+        .help("Floating-point precision: double, float or mixed (double UVW, float grids and images) (default: PRECISION from config.json).");
+
+    program.add_argument("--serve")
+        .default_value(std::string(""))
+        .help("Run as a persistent server reading JSON requests from stdin, fifo:<path> or unix:<path> (default: disabled).");
+
+    program.add_argument("--serve_workers")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of worker threads of --serve (default: 0 = all hardware threads).");
+
+    program.add_argument("--serve_batch")
+        .default_value(4)
+        .scan<'i', int>()
+        .help("Number of directions per worker task of --serve (default: 4).");
+
     try {
         program.parse_args(argc, argv);
     } catch (const std::runtime_error& err) {
@@ -72,6 +399,142 @@ int main(int argc, char* argv[]) {
     const std::string image_dir = program.get<std::string>("--image_dir");
     const std::string save_images_str = program.get<std::string>("--save_images");
     const bool save_images = (save_images_str == "true");
+    const std::string output_format_name = program.get<std::string>("--output_format");
+    const int image_batch = program.get<int>("--image_batch");
+    const std::string visibilities_path = program.get<std::string>("--visibilities");
+    const int memory_budget = program.get<int>("--memory_budget");
+    const std::string export_visibilities_path = program.get<std::string>("--export_visibilities");
+    const std::string backend_name = program.get<std::string>("--backend");
+    const int num_threads = program.get<int>("--threads");
+    const std::string gridder_name = program.get<std::string>("--gridder");
+    const std::string plan_cache_dir = program.get<std::string>("--plan_cache");
+    const bool use_plan = !plan_cache_dir.empty();
+    const std::string wstack_str = program.get<std::string>("--wstack");
+    const bool use_wstack = (wstack_str == "true");
+    const int num_w_planes = program.get<int>("--w_planes");
+    std::string precision_name = program.get<std::string>("--precision");
+    const std::string serve_endpoint = program.get<std::string>("--serve");
+    const int serve_workers = program.get<int>("--serve_workers");
+    const int serve_batch = program.get<int>("--serve_batch");
+    if (precision_name.empty()) {
+        precision_name = config::PRECISION;
+    }
+
+    GridderMode gridder;
+    if (!parseGridderMode(gridder_name, gridder)) {
+        std::cerr << "Error: Unknown gridder '" << gridder_name << "' (expected scatter or tiled).\n";
+        return 1;
+    }
+
+    Precision precision;
+    if (!parsePrecision(precision_name, precision)) {
+        std::cerr << "Error: Unknown precision '" << precision_name << "' (expected double, float or mixed).\n";
+        return 1;
+    }
+
+    OutputFormat output_format;
+    if (!parseOutputFormat(output_format_name, output_format)) {
+        std::cerr << "Error: Unknown output format '" << output_format_name << "' (expected csv, raw, npy or fits).\n";
+        return 1;
+    }
+
+    if (image_batch < 0) {
+        std::cerr << "Error: --image_batch must be non-negative.\n";
+        return 1;
+    }
+
+    if (image_batch > 0 && (use_wstack || use_plan)) {
+        std::cerr << "Error: --image_batch cannot be combined with --wstack or --plan_cache.\n";
+        return 1;
+    }
+
+    if (image_batch > 0 && !use_predefined_params) {
+        std::cerr << "Error: --image_batch requires --use_predefined_params true (otherwise the grid is sized from the first direction of each batch).\n";
+        return 1;
+    }
+
+    if (num_threads < 0) {
+        std::cerr << "Error: --threads must be non-negative.\n";
+        return 1;
+    }
+
+    if (num_w_planes < 0) {
+        std::cerr << "Error: --w_planes must be non-negative.\n";
+        return 1;
+    }
+
+    if (use_wstack && use_plan) {
+        std::cerr << "Error: --wstack cannot be combined with --plan_cache (gridding plans do not bin by w).\n";
+        return 1;
+    }
+
+    if (precision != Precision::Double && (use_wstack || use_plan)) {
+        std::cerr << "Error: --wstack and --plan_cache are only available in double precision.\n";
+        return 1;
+    }
+
+    if (!visibilities_path.empty() && (use_wstack || use_plan || image_batch > 0 || precision != Precision::Double)) {
+        std::cerr << "Error: --visibilities cannot be combined with --wstack, --plan_cache, --image_batch or reduced precision.\n";
+        return 1;
+    }
+
+    if (memory_budget <= 0) {
+        std::cerr << "Error: --memory_budget must be positive.\n";
+        return 1;
+    }
+
+    if (!export_visibilities_path.empty() && (use_plan || precision != Precision::Double)) {
+        std::cerr << "Error: --export_visibilities cannot be combined with --plan_cache or reduced precision.\n";
+        return 1;
+    }
+
+    if (!serve_endpoint.empty()) {
+        if (use_wstack || use_plan || image_batch > 0 || !visibilities_path.empty() || !export_visibilities_path.empty() ||
+            precision != Precision::Double) {
+            std::cerr << "Error: --serve cannot be combined with --wstack, --plan_cache, --image_batch, --visibilities, "
+                         "--export_visibilities or reduced precision.\n";
+            return 1;
+        }
+        if (!use_predefined_params) {
+            std::cerr << "Error: --serve requires --use_predefined_params true (otherwise the grid is sized from the first direction of each task).\n";
+            return 1;
+        }
+        if (serve_workers < 0 || serve_batch <= 0) {
+            std::cerr << "Error: --serve_workers must be non-negative and --serve_batch positive.\n";
+            return 1;
+        }
+
+        // The array geometry is read once and shared by every request
+        std::vector<double> x_m, y_m, z_m;
+        readXYZCoordinates(input_path, x_m, y_m, z_m);
+        if (x_m.size() < 2) {
+            std::cerr << "Error: --serve needs at least two antennas in " << input_path << ".\n";
+            return 1;
+        }
+
+        const ServeOptions serve_options{serve_endpoint, backend_name, static_cast<unsigned>(serve_workers),
+                                         static_cast<unsigned>(num_threads), static_cast<size_t>(serve_batch),
+                                         config::IMAGE_SIZE, use_predefined_params, gridder, save_images, image_dir,
+                                         output_format, static_cast<size_t>(memory_budget)};
+        ImagingServer server(serve_options, x_m, y_m, z_m);
+        if (!server.init()) {
+            std::cerr << "Error: Unknown backend '" << backend_name << "' (expected cuda or cpu).\n";
+            return 1;
+        }
+        return server.run();
+    }
+
+    std::unique_ptr<ImagingBackend> backend = makeBackend(backend_name, static_cast<unsigned>(num_threads));
+    if (!backend) {
+        std::cerr << "Error: Unknown backend '" << backend_name << "' (expected cuda or cpu).\n";
+        return 1;
+    }
+
+    const OutputOptions output{output_uvw, uvw_dir, save_images, image_dir, output_format};
+    if (!visibilities_path.empty()) {
+        return imageVisibilityFile(*backend, visibilities_path, config::IMAGE_SIZE, use_predefined_params,
+                                   static_cast<size_t>(memory_budget), output);
+    }
 
     std::vector<double> HAs, Decs;
     readDirections(directions_path, HAs, Decs);
@@ -87,37 +550,116 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    auto start_uvw = std::chrono::high_resolution_clock::now();
-    computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w);
-    auto stop_uvw = std::chrono::high_resolution_clock::now();
-    auto duration_uvw = std::chrono::duration_cast<std::chrono::milliseconds>(stop_uvw - start_uvw);
-    std::cout << "UVW computation complete. Execution time: " << duration_uvw.count() << " ms\n";
+    if (precision == Precision::Float) {
+        return imageReducedPrecision<float>(*backend, x_m, y_m, z_m, HAs, Decs, image_size, use_predefined_params, gridder,
+                                            static_cast<size_t>(image_batch), output, precision_name) ? 0 : 1;
+    }
+    if (precision == Precision::Mixed) {
+        return imageReducedPrecision<double>(*backend, x_m, y_m, z_m, HAs, Decs, image_size, use_predefined_params, gridder,
+                                             static_cast<size_t>(image_batch), output, precision_name) ? 0 : 1;
+    }
+
+    GriddingPlan plan;
+    bool plan_loaded = false;
+    std::uint64_t plan_key = 0;
+    std::string plan_path;
+    if (use_plan) {
+        plan_key = GriddingPlan::computeKey(x_m, y_m, z_m, HAs, Decs, image_size, use_predefined_params, config::PREDEFINED_MAX_UV);
+        plan_path = GriddingPlan::cachePath(plan_cache_dir, plan_key);
+        plan_loaded = plan.load(plan_path, plan_key);
+        if (plan_loaded) {
+            std::cout << "Loaded gridding plan: " << plan_path << "\n";
+        }
+    }
+
+    // UVW coordinates are only needed when there is no cached plan or when they are saved
+    std::chrono::milliseconds duration_uvw(0);
+    if (!plan_loaded || output_uvw) {
+        auto start_uvw = std::chrono::high_resolution_clock::now();
+        backend->computeUVW(x_m, y_m, z_m, HAs, Decs, u, v, w);
+        auto stop_uvw = std::chrono::high_resolution_clock::now();
+        duration_uvw = std::chrono::duration_cast<std::chrono::milliseconds>(stop_uvw - start_uvw);
+        std::cout << "UVW computation complete. Execution time: " << duration_uvw.count() << " ms\n";
+    }
+
+    if (!export_visibilities_path.empty()) {
+        std::vector<std::vector<std::complex<double>>> unit_visibilities(u.size(), std::vector<std::complex<double>>(u[0].size(), std::complex<double>(1, 0)));
+        if (!writeVisibilityFile(export_visibilities_path, u, v, w, unit_visibilities)) {
+            return 1;
+        }
+        std::cout << "Visibilities saved to " << export_visibilities_path << "\n";
+    }
 
+    // UVW coordinates are written by the writer thread while the imaging runs. The writer is
+    // declared last so that it finishes before the outputs it writes to are destroyed.
+    UVWWriter<double> uvw_writer;
+    ImageWriter<double> image_writer;
+    AsyncWriter writer(OUTPUT_QUEUE_CAPACITY);
     if (output_uvw) {
-        saveUVWCoordinates(u, v, w, uvw_dir);
+        if (!uvw_writer.open(output_format, uvw_dir, u.size(), u[0].size())) {
+            return 1;
+        }
+        queueUVW(writer, uvw_writer, u, v, w);
+    }
+    if (save_images && !image_writer.open(output_format, image_dir, HAs.size(), image_size)) {
+        return 1;
+    }
+
+    if (use_plan && !plan_loaded) {
+        auto start_plan = std::chrono::high_resolution_clock::now();
+        double max_uv = use_predefined_params ? config::PREDEFINED_MAX_UV : *std::max_element(u[0].begin(), u[0].end());
+        plan.build(u, v, image_size, max_uv, plan_key, static_cast<unsigned>(num_threads));
+        fs::create_directories(plan_cache_dir);
+        plan.save(plan_path);
+        auto stop_plan = std::chrono::high_resolution_clock::now();
+        auto duration_plan = std::chrono::duration_cast<std::chrono::milliseconds>(stop_plan - start_plan);
+        std::cout << "Gridding plan built and saved to " << plan_path << ". Execution time: " << duration_plan.count() << " ms\n";
     }
 
     int num_batches = HAs.size();
-    std::vector<std::vector<std::complex<double>>> visibilities(num_batches, std::vector<std::complex<double>>(u[0].size(), std::complex<double>(1, 0)));
-    std::vector<std::vector<double>> images;
+    std::vector<WPlaneTiming> plane_timings;
 
     auto start = std::chrono::high_resolution_clock::now();
-    uniformImage(visibilities, u, v, image_size, images, use_predefined_params);
+    if (use_wstack || use_plan) {
+        size_t num_baselines = plan_loaded ? plan.numBaselines() : u[0].size();
+        std::vector<std::vector<std::complex<double>>> visibilities(num_batches, std::vector<std::complex<double>>(num_baselines, std::complex<double>(1, 0)));
+        auto images = std::make_shared<std::vector<std::vector<double>>>();
+        if (use_wstack) {
+            backend->wStackImage(visibilities, u, v, w, image_size, *images, use_predefined_params, num_w_planes, plane_timings);
+        } else {
+            backend->planImage(plan, visibilities, *images);
+        }
+        if (save_images) {
+            queueImages(writer, image_writer, images, 0);
+        }
+    } else {
+        imageInBatches(*backend, u, v, image_size, use_predefined_params, gridder, static_cast<size_t>(image_batch), writer,
+                       save_images ? &image_writer : nullptr);
+    }
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-    std::cout << "Imaging complete. Execution time: " << duration.count() << " ms\n";
+    std::cout << "Imaging complete (" << backend->name() << " backend). Execution time: " << duration.count() << " ms\n";
+
+    if (use_wstack) {
+        for (const WPlaneTiming& timing : plane_timings) {
+            std::cout << "W-plane " << timing.plane << ": " << timing.num_visibilities << " visibilities, " << timing.time_ms << " ms\n";
+        }
+        std::cout << "W-stacking imaged " << plane_timings.size() << " non-empty w-planes.\n";
+    }
 
     std::ofstream log_file("output.log", std::ios_base::app);
     log_file << "UVW computation time: " << duration_uvw.count() << " ms\n";
     log_file << "Imaging time: " << duration.count() << " ms\n";
     log_file.close();
 
+    finishOutput(writer);
+    if (output_uvw) {
+        uvw_writer.close();
+    }
     if (save_images) {
-        saveImages(images, image_size, image_dir);
+        image_writer.close();
     }
 
-    // Reset the GPU
-    cudaDeviceReset();
-
+    reportPeakMemory();
     return 0;
 }
\ No newline at end of file
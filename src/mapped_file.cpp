@@ -0,0 +1,105 @@
+#include "mapped_file.hpp"
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+/**
+ * @brief Map an existing file read-only.
+ *
+ * @param filename Path of the file.
+ * @return true if the file was mapped (an empty file is opened with a null mapping).
+ */
+bool MappedFile::openRead(const std::string& filename) {
+    close();
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        close();
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) {
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data_ = static_cast<char*>(mapping);
+    madvise(data_, size_, MADV_SEQUENTIAL);
+    return true;
+}
+
+/**
+ * @brief Create (or truncate) a file of a fixed size and map it for writing.
+ *
+ * The file is preallocated with posix_fallocate where the file system supports it,
+ * so that running out of disk space is reported here rather than as a SIGBUS while
+ * the mapping is filled.
+ *
+ * @param filename Path of the file.
+ * @param size Size of the file in bytes.
+ * @return true if the file was created and mapped.
+ */
+bool MappedFile::create(const std::string& filename, size_t size) {
+    close();
+    fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Error creating file: " << filename << "\n";
+        return false;
+    }
+
+    if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Error resizing file: " << filename << "\n";
+        close();
+        return false;
+    }
+    int status = posix_fallocate(fd_, 0, static_cast<off_t>(size));
+    if (status != 0 && status != EOPNOTSUPP && status != EINVAL) {
+        std::cerr << "Error preallocating " << size << " bytes for file: " << filename << "\n";
+        close();
+        return false;
+    }
+
+    size_ = size;
+    if (size_ == 0) {
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << filename << "\n";
+        close();
+        return false;
+    }
+    data_ = static_cast<char*>(mapping);
+    return true;
+}
+
+/**
+ * @brief Unmap and close the file.
+ */
+void MappedFile::close() {
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
@@ -0,0 +1,283 @@
+#include "output_writer.hpp"
+#include "data_io.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char RAW_MAGIC[8] = {'R', 'I', 'M', 'G', 'C', 'U', 'B', 'E'};
+const std::uint32_t RAW_VERSION = 1;
+const size_t RAW_HEADER_SIZE = 64;
+const size_t FITS_BLOCK_SIZE = 2880;
+const size_t FITS_CARD_SIZE = 80;
+
+bool hostIsLittleEndian() {
+    const std::uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+/**
+ * @brief Append value to header in little-endian byte order.
+ */
+template <typename T>
+void appendLittleEndian(std::string& header, T value) {
+    for (size_t b = 0; b < sizeof(T); ++b) {
+        header.push_back(static_cast<char>((static_cast<std::uint64_t>(value) >> (8 * b)) & 0xff));
+    }
+}
+
+std::string rawHeader(size_t element_size, size_t dim0, size_t dim1, size_t dim2) {
+    std::string header(RAW_MAGIC, sizeof(RAW_MAGIC));
+    appendLittleEndian(header, RAW_VERSION);
+    appendLittleEndian(header, static_cast<std::uint32_t>(element_size));
+    appendLittleEndian(header, static_cast<std::uint64_t>(dim0));
+    appendLittleEndian(header, static_cast<std::uint64_t>(dim1));
+    appendLittleEndian(header, static_cast<std::uint64_t>(dim2));
+    header.resize(RAW_HEADER_SIZE, '\0');
+    return header;
+}
+
+/**
+ * @brief NumPy .npy (format version 1.0) header, padded so the data starts at a multiple of 64 bytes.
+ */
+std::string npyHeader(size_t element_size, size_t dim0, size_t dim1, size_t dim2) {
+    std::string dict = "{'descr': '<f" + std::to_string(element_size) + "', 'fortran_order': False, 'shape': (" +
+                       std::to_string(dim0) + ", " + std::to_string(dim1) + ", " + std::to_string(dim2) + "), }";
+    const size_t preamble = 10; // magic (6), version (2), header length (2)
+    size_t total = preamble + dict.size() + 1;
+    total = (total + 63) / 64 * 64;
+    dict.resize(total - preamble - 1, ' ');
+    dict.push_back('\n');
+
+    std::string header("\x93NUMPY\x01\x00", 8);
+    appendLittleEndian(header, static_cast<std::uint16_t>(dict.size()));
+    return header + dict;
+}
+
+std::string fitsCard(const std::string& keyword, const std::string& value) {
+    char card[FITS_CARD_SIZE + 1];
+    std::snprintf(card, sizeof(card), "%-8s= %20s", keyword.c_str(), value.c_str());
+    std::string result(card);
+    result.resize(FITS_CARD_SIZE, ' ');
+    return result;
+}
+
+/**
+ * @brief FITS primary header of a 3-D IEEE float cube; NAXIS1 is the fastest axis (dim2).
+ */
+std::string fitsHeader(size_t element_size, size_t dim0, size_t dim1, size_t dim2) {
+    std::string header;
+    header += fitsCard("SIMPLE", "T");
+    header += fitsCard("BITPIX", element_size == 4 ? "-32" : "-64");
+    header += fitsCard("NAXIS", "3");
+    header += fitsCard("NAXIS1", std::to_string(dim2));
+    header += fitsCard("NAXIS2", std::to_string(dim1));
+    header += fitsCard("NAXIS3", std::to_string(dim0));
+    header += std::string("END").append(FITS_CARD_SIZE - 3, ' ');
+    header.resize((header.size() + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE, ' ');
+    return header;
+}
+
+}
+
+/**
+ * @brief Parse an output format name ("csv", "raw", "npy" or "fits").
+ *
+ * @param name Format name.
+ * @param format Parsed format.
+ * @return true if the name is valid.
+ */
+bool parseOutputFormat(const std::string& name, OutputFormat& format) {
+    if (name == "csv") {
+        format = OutputFormat::Csv;
+    } else if (name == "raw") {
+        format = OutputFormat::Raw;
+    } else if (name == "npy") {
+        format = OutputFormat::Npy;
+    } else if (name == "fits") {
+        format = OutputFormat::Fits;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief File extension of an output format.
+ */
+const char* outputFormatExtension(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::Raw: return "raw";
+        case OutputFormat::Npy: return "npy";
+        case OutputFormat::Fits: return "fits";
+        default: return "csv";
+    }
+}
+
+/**
+ * @brief Create the cube file with its header and map the data for writing.
+ *
+ * @param filename Path of the file.
+ * @param format Raw, Npy or Fits.
+ * @param dim0 Slowest dimension.
+ * @param dim1 Middle dimension.
+ * @param dim2 Fastest dimension.
+ * @return true if the file was created.
+ */
+template <typename Real>
+bool CubeFile<Real>::create(const std::string& filename, OutputFormat format, size_t dim0, size_t dim1, size_t dim2) {
+    std::string header;
+    if (format == OutputFormat::Npy) {
+        header = npyHeader(sizeof(Real), dim0, dim1, dim2);
+    } else if (format == OutputFormat::Fits) {
+        header = fitsHeader(sizeof(Real), dim0, dim1, dim2);
+    } else {
+        header = rawHeader(sizeof(Real), dim0, dim1, dim2);
+    }
+
+    size_t file_size = header.size() + dim0 * dim1 * dim2 * sizeof(Real);
+    if (format == OutputFormat::Fits) {
+        // The data unit is padded with zeros to a whole number of blocks
+        file_size = (file_size + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE;
+    }
+    if (!file_.create(filename, file_size)) {
+        return false;
+    }
+
+    std::memcpy(file_.data(), header.data(), header.size());
+    filename_ = filename;
+    header_size_ = header.size();
+    // FITS data is big-endian, raw and npy cubes are little-endian
+    swap_bytes_ = (format == OutputFormat::Fits) == hostIsLittleEndian();
+    return true;
+}
+
+/**
+ * @brief Prepare the output directory and, for binary formats, the preallocated image cube.
+ *
+ * @param format Output format.
+ * @param directory The directory to save the images.
+ * @param num_images Number of images (directions).
+ * @param image_size Size of the images.
+ * @return true if the output was created.
+ */
+template <typename Real>
+bool ImageWriter<Real>::open(OutputFormat format, const std::string& directory, size_t num_images, int image_size) {
+    format_ = format;
+    directory_ = directory;
+    num_images_ = num_images;
+    image_size_ = image_size;
+    fs::create_directories(directory);
+    if (format == OutputFormat::Csv) {
+        return true;
+    }
+    return cube_.create(directory + "/images." + outputFormatExtension(format), format, num_images, image_size, image_size);
+}
+
+/**
+ * @brief Write the image of one direction.
+ *
+ * @param index Index of the image.
+ * @param image The image (image_size x image_size, row-major).
+ */
+template <typename Real>
+void ImageWriter<Real>::write(size_t index, const std::vector<Real>& image) {
+    if (format_ == OutputFormat::Csv) {
+        saveImageCSV(image, image_size_, directory_, index);
+        return;
+    }
+    const size_t pixels = static_cast<size_t>(image_size_) * image_size_;
+    cube_.store(index * pixels, image.data(), pixels);
+}
+
+/**
+ * @brief Close the output and report where the images were saved.
+ *
+ * @param report Print the report to stdout (disabled by --serve, whose stdout carries responses).
+ */
+template <typename Real>
+void ImageWriter<Real>::close(bool report) {
+    if (format_ != OutputFormat::Csv) {
+        cube_.close();
+    }
+    if (report) {
+        std::cout << num_images_ << " images saved to " << location() << "\n";
+    }
+}
+
+/**
+ * @brief The directory (CSV) or cube file (binary formats) the images are saved to.
+ */
+template <typename Real>
+std::string ImageWriter<Real>::location() const {
+    return format_ == OutputFormat::Csv ? directory_ : cube_.filename();
+}
+
+/**
+ * @brief Prepare the output directory and, for binary formats, the preallocated UVW cube.
+ *
+ * @param format Output format.
+ * @param directory The directory to save the UVW coordinates.
+ * @param num_directions Number of directions.
+ * @param num_baselines Number of baselines per direction.
+ * @return true if the output was created.
+ */
+template <typename Real>
+bool UVWWriter<Real>::open(OutputFormat format, const std::string& directory, size_t num_directions, size_t num_baselines) {
+    format_ = format;
+    directory_ = directory;
+    num_directions_ = num_directions;
+    num_baselines_ = num_baselines;
+    fs::create_directories(directory);
+    if (format == OutputFormat::Csv) {
+        return true;
+    }
+    return cube_.create(directory + "/uvw_coordinates." + outputFormatExtension(format), format, num_directions, num_baselines, 3);
+}
+
+/**
+ * @brief Write the UVW coordinates of one direction.
+ *
+ * @param direction Index of the direction.
+ * @param u U coordinates of the direction.
+ * @param v V coordinates of the direction.
+ * @param w W coordinates of the direction.
+ */
+template <typename Real>
+void UVWWriter<Real>::write(size_t direction, const std::vector<Real>& u, const std::vector<Real>& v, const std::vector<Real>& w) {
+    if (format_ == OutputFormat::Csv) {
+        saveUVWCoordinatesCSV(u, v, w, directory_, direction);
+        return;
+    }
+    size_t index = direction * num_baselines_ * 3;
+    for (size_t i = 0; i < num_baselines_; ++i, index += 3) {
+        cube_.store(index, u[i]);
+        cube_.store(index + 1, v[i]);
+        cube_.store(index + 2, w[i]);
+    }
+}
+
+/**
+ * @brief Close the output and report where the UVW coordinates were saved.
+ */
+template <typename Real>
+void UVWWriter<Real>::close() {
+    if (format_ == OutputFormat::Csv) {
+        std::cout << "UVW coordinates of " << num_directions_ << " directions saved to " << directory_ << "\n";
+    } else {
+        cube_.close();
+        std::cout << "UVW coordinates of " << num_directions_ << " directions saved to " << cube_.filename() << "\n";
+    }
+}
+
+template class CubeFile<float>;
+template class CubeFile<double>;
+template class ImageWriter<float>;
+template class ImageWriter<double>;
+template class UVWWriter<float>;
+template class UVWWriter<double>;
@@ -0,0 +1,592 @@
+#include "server.hpp"
+#include "config.hpp"
+#include "parallel.hpp"
+#include "visibility_io.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+const char FIFO_PREFIX[] = "fifo:";
+const char UNIX_PREFIX[] = "unix:";
+
+bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+json errorResponse(const json& id, const std::string& message) {
+    json response = {{"status", "error"}, {"error", message}};
+    if (!id.is_null()) {
+        response["id"] = id;
+    }
+    return response;
+}
+
+/**
+ * @brief A client of the Unix socket endpoint; closed when the last pending response is sent.
+ */
+struct Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+
+    void send(const std::string& response) {
+        const std::string data = response + "\n";
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t sent = 0;
+        while (sent < data.size()) {
+            // MSG_NOSIGNAL: a client that went away must not raise SIGPIPE in the server
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    int fd;
+    std::mutex mutex;
+};
+
+}
+
+/**
+ * @brief Record the latency of a finished request.
+ */
+void LatencyStats::record(double milliseconds) {
+    if (window_.size() < LATENCY_WINDOW) {
+        window_.push_back(milliseconds);
+    } else {
+        window_[next_] = milliseconds;
+    }
+    next_ = (next_ + 1) % LATENCY_WINDOW;
+    ++count_;
+}
+
+/**
+ * @brief Nearest-rank percentile of the recorded latencies.
+ *
+ * @param p Percentile in [0, 100].
+ * @return double The latency in ms (0 if nothing was recorded).
+ */
+double LatencyStats::percentile(double p) const {
+    if (window_.empty()) return 0.0;
+    std::vector<double> sorted(window_);
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    size_t index = std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+/**
+ * @brief State of one request, shared by its tasks; the last task to finish answers it.
+ */
+struct ImagingServer::Request {
+    size_t number = 0;
+    json id;
+    Clock::time_point received;
+    Responder respond;
+    int image_size = 0;
+    std::vector<double> HAs, Decs;
+    size_t num_directions = 0;
+    bool save_images = false;
+    ImageWriter<double> image_writer;
+    std::atomic<size_t> remaining{0};
+    std::mutex mutex;
+    std::string error;
+
+    void fail(const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error.empty()) {
+            error = message;
+        }
+    }
+};
+
+/**
+ * @brief Create the server; the antenna coordinates must outlive it.
+ *
+ * @param options Server settings.
+ * @param x_m X coordinates of the antennas.
+ * @param y_m Y coordinates of the antennas.
+ * @param z_m Z coordinates of the antennas.
+ */
+ImagingServer::ImagingServer(const ServeOptions& options,
+                             const std::vector<double>& x_m, const std::vector<double>& y_m, const std::vector<double>& z_m)
+    : options_(options), x_m_(x_m), y_m_(y_m), z_m_(z_m) {}
+
+ImagingServer::~ImagingServer() {
+    pool_.reset();
+}
+
+/**
+ * @brief Create the backends and start the worker pool.
+ *
+ * @return true if the backend name is known.
+ */
+bool ImagingServer::init() {
+    const unsigned num_workers = resolveThreadCount(options_.num_workers);
+    if (options_.backend_name == "cpu") {
+        // Every worker has its own engine with an equal share of the threads
+        const unsigned threads_per_worker = std::max(1u, resolveThreadCount(options_.num_threads) / num_workers);
+        for (unsigned w = 0; w < num_workers; ++w) {
+            backends_.push_back(makeCpuBackend(threads_per_worker));
+        }
+    } else {
+        std::unique_ptr<ImagingBackend> backend = makeBackend(options_.backend_name, options_.num_threads);
+        if (!backend) {
+            return false;
+        }
+        backends_.push_back(std::move(backend));
+        shared_backend_ = true;
+    }
+
+    workers_.resize(num_workers);
+    for (unsigned w = 0; w < num_workers; ++w) {
+        workers_[w].backend = backends_[shared_backend_ ? 0 : w].get();
+    }
+    pool_ = std::make_unique<WorkStealingPool>(num_workers);
+    return true;
+}
+
+/**
+ * @brief Serve requests on the endpoint until it is exhausted or a shutdown command arrives.
+ *
+ * @return int Exit status of the program.
+ */
+int ImagingServer::run() {
+    std::cerr << "Serving " << x_m_.size() << " antennas on " << options_.endpoint << " with " << workers_.size()
+              << " workers (" << backends_[0]->name() << " backend)\n";
+
+    int status;
+    if (options_.endpoint == "stdin") {
+        status = serveStream(std::cin);
+    } else if (startsWith(options_.endpoint, FIFO_PREFIX)) {
+        status = serveFifo(options_.endpoint.substr(std::strlen(FIFO_PREFIX)));
+    } else if (startsWith(options_.endpoint, UNIX_PREFIX)) {
+        status = serveUnixSocket(options_.endpoint.substr(std::strlen(UNIX_PREFIX)));
+    } else {
+        std::cerr << "Error: Unknown endpoint '" << options_.endpoint << "' (expected stdin, fifo:<path> or unix:<path>).\n";
+        return 1;
+    }
+    pool_->wait();
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    std::cerr << "Served " << latencies_.count() << " requests (" << failed_requests_ << " failed), "
+              << directions_imaged_ << " directions. Latency p50: " << latencies_.percentile(50)
+              << " ms, p95: " << latencies_.percentile(95) << " ms, p99: " << latencies_.percentile(99) << " ms\n";
+    return status;
+}
+
+/**
+ * @brief Parse one request line and queue its work.
+ *
+ * @param line The JSON request.
+ * @param received When the line was read (start of the request latency).
+ * @param respond Sends a response line to the client of the request.
+ */
+void ImagingServer::handleLine(const std::string& line, Clock::time_point received, const Responder& respond) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        return;
+    }
+
+    json message = json::parse(line, nullptr, false);
+    if (message.is_discarded() || !message.is_object()) {
+        respond(errorResponse(nullptr, "request is not a JSON object").dump());
+        return;
+    }
+
+    if (message.contains("command")) {
+        const std::string command = message["command"].is_string() ? message["command"].get<std::string>() : "";
+        if (command == "stats") {
+            respond(statsResponse());
+        } else if (command == "shutdown") {
+            respond(json{{"status", "ok"}, {"command", "shutdown"}}.dump());
+            requestShutdown();
+        } else {
+            respond(errorResponse(nullptr, "unknown command (expected stats or shutdown)").dump());
+        }
+        return;
+    }
+
+    auto request = std::make_shared<Request>();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        request->number = next_request_++;
+    }
+    request->id = message.contains("id") ? message["id"] : json(request->number);
+    request->received = received;
+    request->respond = respond;
+
+    const json& image_size = message.contains("image_size") ? message["image_size"] : json(options_.image_size);
+    if (!image_size.is_number_integer() || image_size.get<int>() <= 0) {
+        respond(errorResponse(request->id, "image_size must be a positive integer").dump());
+        return;
+    }
+    request->image_size = image_size.get<int>();
+
+    if (message.contains("directions")) {
+        const json& directions = message["directions"];
+        std::vector<double> HAs, Decs;
+        bool valid = directions.is_array() && !directions.empty();
+        for (size_t d = 0; valid && d < directions.size(); ++d) {
+            const json& direction = directions[d];
+            valid = direction.is_array() && direction.size() == 2 && direction[0].is_number() && direction[1].is_number();
+            if (valid) {
+                HAs.push_back(direction[0].get<double>());
+                Decs.push_back(direction[1].get<double>());
+            }
+        }
+        if (!valid) {
+            respond(errorResponse(request->id, "directions must be a non-empty list of [ha, dec] pairs").dump());
+            return;
+        }
+        submitDirections(request, std::move(HAs), std::move(Decs));
+    } else if (message.contains("visibilities") && message["visibilities"].is_string()) {
+        submitVisibilities(request, message["visibilities"].get<std::string>());
+    } else {
+        respond(errorResponse(request->id, "expected directions or visibilities").dump());
+    }
+}
+
+/**
+ * @brief Split a direction request into tasks of batch_directions directions and queue them.
+ */
+void ImagingServer::submitDirections(const std::shared_ptr<Request>& request, std::vector<double> HAs, std::vector<double> Decs) {
+    request->HAs = std::move(HAs);
+    request->Decs = std::move(Decs);
+    request->num_directions = request->HAs.size();
+
+    if (options_.save_images) {
+        const std::string directory = options_.image_dir + "/request_" + std::to_string(request->number);
+        if (!request->image_writer.open(options_.format, directory, request->num_directions, request->image_size)) {
+            request->respond(errorResponse(request->id, "cannot create the image output in " + directory).dump());
+            return;
+        }
+        request->save_images = true;
+    }
+
+    const size_t batch = std::max<size_t>(options_.batch_directions, 1);
+    request->remaining = (request->num_directions + batch - 1) / batch;
+    for (size_t first = 0; first < request->num_directions; first += batch) {
+        const size_t count = std::min(batch, request->num_directions - first);
+        pool_->submit([this, request, first, count](unsigned worker) {
+            imageBatch(*request, first, count, worker);
+            finishTask(*request);
+        });
+    }
+}
+
+/**
+ * @brief Queue a visibility file request as a single task (the file is streamed block by block).
+ */
+void ImagingServer::submitVisibilities(const std::shared_ptr<Request>& request, const std::string& filename) {
+    request->remaining = 1;
+    pool_->submit([this, request, filename](unsigned worker) {
+        imageFile(*request, filename, worker);
+        finishTask(*request);
+    });
+}
+
+/**
+ * @brief Compute the UVW coordinates and images of count directions of a request.
+ *
+ * @param request The request.
+ * @param first Index of the first direction of the task.
+ * @param count Number of directions of the task.
+ * @param worker Index of the worker running the task.
+ */
+void ImagingServer::imageBatch(Request& request, size_t first, size_t count, unsigned worker) {
+    Workspace& ws = workspace(worker, count, request.image_size);
+    ws.HAs.assign(request.HAs.begin() + first, request.HAs.begin() + first + count);
+    ws.Decs.assign(request.Decs.begin() + first, request.Decs.begin() + first + count);
+
+    ImagingBackend& backend = *workers_[worker].backend;
+    {
+        std::unique_lock<std::mutex> lock(backend_mutex_, std::defer_lock);
+        if (shared_backend_) {
+            lock.lock();
+        }
+        backend.computeUVW(x_m_, y_m_, z_m_, ws.HAs, ws.Decs, ws.u, ws.v, ws.w);
+        // Unit visibilities; entries kept from earlier tasks are already (1, 0)
+        ws.visibilities.resize(count);
+        for (auto& visibilities : ws.visibilities) {
+            visibilities.resize(ws.u[0].size(), std::complex<double>(1, 0));
+        }
+        backend.uniformImage(ws.visibilities, ws.u, ws.v, request.image_size, ws.images,
+                             options_.use_predefined_params, options_.gridder);
+    }
+
+    if (request.save_images) {
+        for (size_t d = 0; d < count; ++d) {
+            request.image_writer.write(first + d, ws.images[d]);
+        }
+    }
+}
+
+/**
+ * @brief Stream a visibility file through the backend and save its images.
+ *
+ * @param request The request.
+ * @param filename Path of the visibility file.
+ * @param worker Index of the worker running the task.
+ */
+void ImagingServer::imageFile(Request& request, const std::string& filename, unsigned worker) {
+    VisibilityStream stream;
+    if (!stream.open(filename)) {
+        request.fail("cannot read visibility file " + filename);
+        return;
+    }
+    const size_t block_visibilities = streamBlockVisibilities(stream, request.image_size, options_.memory_budget_mb);
+    if (block_visibilities == 0) {
+        request.fail("the memory budget does not fit the grids and images of the visibility file");
+        return;
+    }
+    request.num_directions = stream.numDirections();
+
+    const double max_uv = (options_.use_predefined_params || stream.numDirections() == 0) ? config::PREDEFINED_MAX_UV : stream.maxU(0);
+    Workspace& ws = workspace(worker, request.num_directions, request.image_size);
+    stream.start(block_visibilities);
+    {
+        std::unique_lock<std::mutex> lock(backend_mutex_, std::defer_lock);
+        if (shared_backend_) {
+            lock.lock();
+        }
+        workers_[worker].backend->streamImage(stream, request.image_size, max_uv, ws.images);
+    }
+    if (stream.failed()) {
+        request.fail("error reading visibility file " + filename);
+        return;
+    }
+
+    if (options_.save_images) {
+        const std::string directory = options_.image_dir + "/request_" + std::to_string(request.number);
+        if (!request.image_writer.open(options_.format, directory, request.num_directions, request.image_size)) {
+            request.fail("cannot create the image output in " + directory);
+            return;
+        }
+        request.save_images = true;
+        for (size_t d = 0; d < request.num_directions; ++d) {
+            request.image_writer.write(d, ws.images[d]);
+        }
+    }
+}
+
+/**
+ * @brief Mark a task of the request as done; the last one records the latency and sends the response.
+ */
+void ImagingServer::finishTask(Request& request) {
+    if (request.remaining.fetch_sub(1) != 1) {
+        return;
+    }
+
+    if (request.save_images) {
+        request.image_writer.close(false);
+    }
+    const double latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - request.received).count();
+
+    json response;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        if (!request.error.empty()) {
+            ++failed_requests_;
+            response = errorResponse(request.id, request.error);
+        } else {
+            latencies_.record(latency_ms);
+            directions_imaged_ += request.num_directions;
+            response = {{"id", request.id}, {"status", "ok"}, {"request", request.number},
+                        {"directions", request.num_directions}, {"image_size", request.image_size}};
+            if (request.save_images) {
+                response["images"] = request.image_writer.location();
+            }
+        }
+        response["latency_ms"] = latency_ms;
+        response["latency_p50_ms"] = latencies_.percentile(50);
+        response["latency_p95_ms"] = latencies_.percentile(95);
+        response["latency_p99_ms"] = latencies_.percentile(99);
+    }
+    request.respond(response.dump());
+}
+
+/**
+ * @brief Workspace of a worker for tasks of num_directions directions and image_size.
+ */
+ImagingServer::Workspace& ImagingServer::workspace(unsigned worker, size_t num_directions, int image_size) {
+    auto& workspaces = workers_[worker].workspaces;
+    auto key = std::make_pair(num_directions, image_size);
+    auto it = workspaces.find(key);
+    if (it == workspaces.end()) {
+        it = workspaces.emplace(key, Workspace()).first;
+        ++workspace_buckets_;
+    }
+    return it->second;
+}
+
+/**
+ * @brief Response of the stats command.
+ */
+std::string ImagingServer::statsResponse() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    json response = {{"status", "ok"}, {"command", "stats"},
+                     {"requests", latencies_.count()}, {"failed", failed_requests_},
+                     {"directions", directions_imaged_}, {"workers", workers_.size()},
+                     {"steals", pool_->steals()}, {"workspace_buckets", workspace_buckets_.load()},
+                     {"latency_p50_ms", latencies_.percentile(50)},
+                     {"latency_p95_ms", latencies_.percentile(95)},
+                     {"latency_p99_ms", latencies_.percentile(99)}};
+    return response.dump();
+}
+
+/**
+ * @brief Stop reading requests; queued requests are still answered.
+ */
+void ImagingServer::requestShutdown() {
+    stopping_ = true;
+    if (listen_fd_ >= 0) {
+        // Wakes up accept() in serveUnixSocket
+        ::shutdown(listen_fd_, SHUT_RDWR);
+    }
+}
+
+void ImagingServer::respondStdout(const std::string& response) {
+    std::lock_guard<std::mutex> lock(stdout_mutex_);
+    std::cout << response << std::endl;
+}
+
+/**
+ * @brief Serve the request lines of a stream (stdin or an opened FIFO) with responses on stdout.
+ */
+int ImagingServer::serveStream(std::istream& input) {
+    std::string line;
+    while (!stopping_ && std::getline(input, line)) {
+        handleLine(line, Clock::now(), [this](const std::string& response) { respondStdout(response); });
+    }
+    return 0;
+}
+
+/**
+ * @brief Serve the request lines written to a FIFO; it is reopened whenever its writers close it.
+ *
+ * @param path Path of the FIFO (created if it does not exist).
+ */
+int ImagingServer::serveFifo(const std::string& path) {
+    struct stat info;
+    bool created = false;
+    if (::stat(path.c_str(), &info) == 0) {
+        if (!S_ISFIFO(info.st_mode)) {
+            std::cerr << "Error: " << path << " exists and is not a FIFO.\n";
+            return 1;
+        }
+    } else if (::mkfifo(path.c_str(), 0600) != 0) {
+        std::cerr << "Error creating FIFO " << path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    } else {
+        created = true;
+    }
+
+    while (!stopping_) {
+        // Blocks until a client opens the FIFO for writing
+        std::ifstream fifo(path);
+        if (!fifo.is_open()) {
+            std::cerr << "Error opening FIFO " << path << "\n";
+            return 1;
+        }
+        serveStream(fifo);
+    }
+
+    if (created) {
+        ::unlink(path.c_str());
+    }
+    return 0;
+}
+
+/**
+ * @brief Accept clients on a Unix socket; every connection is read by its own thread and
+ *        receives the responses to its requests.
+ *
+ * @param path Path of the socket (an existing socket file is replaced).
+ */
+int ImagingServer::serveUnixSocket(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path is too long: " << path << "\n";
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Error creating socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 16) != 0) {
+        std::cerr << "Error listening on " << path << ": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return 1;
+    }
+    listen_fd_ = fd;
+
+    std::list<std::thread> readers;
+    std::mutex connections_mutex;
+    std::vector<std::weak_ptr<Connection>> connections;
+    while (!stopping_) {
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        auto connection = std::make_shared<Connection>(client);
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            connections.push_back(connection);
+        }
+        readers.emplace_back([this, connection]() {
+            const Responder respond = [connection](const std::string& response) { connection->send(response); };
+            std::string pending;
+            char buffer[4096];
+            while (!stopping_) {
+                ssize_t n = ::recv(connection->fd, buffer, sizeof(buffer), 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                pending.append(buffer, static_cast<size_t>(n));
+                size_t end;
+                while (!stopping_ && (end = pending.find('\n')) != std::string::npos) {
+                    handleLine(pending.substr(0, end), Clock::now(), respond);
+                    pending.erase(0, end + 1);
+                }
+            }
+        });
+    }
+
+    // Stop reading from the clients that are still connected; their queued requests are still answered
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (const auto& weak : connections) {
+            if (auto connection = weak.lock()) {
+                ::shutdown(connection->fd, SHUT_RD);
+            }
+        }
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    listen_fd_ = -1;
+    ::close(fd);
+    ::unlink(path.c_str());
+    return 0;
+}
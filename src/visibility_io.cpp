@@ -0,0 +1,305 @@
+#include "visibility_io.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+const char VISIBILITY_MAGIC[8] = {'R', 'I', 'V', 'I', 'S', 'B', 'I', 'N'};
+const std::uint32_t VISIBILITY_VERSION = 1;
+
+/// Number of records converted per write or per read of the maxU pass.
+const size_t RECORDS_PER_CHUNK = 65536;
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+double recordValue(const char* record, int field) {
+    double value;
+    std::memcpy(&value, record + field * sizeof(double), sizeof(double));
+    return value;
+}
+
+}
+
+/**
+ * @brief Write visibilities and their UVW coordinates as a binary visibility file.
+ *
+ * @param filename Path of the file.
+ * @param u_batch U coordinates for multiple directions.
+ * @param v_batch V coordinates for multiple directions.
+ * @param w_batch W coordinates for multiple directions.
+ * @param visibilities_batch Visibilities for multiple directions.
+ * @return true if the file was written.
+ */
+bool writeVisibilityFile(const std::string& filename,
+                         const std::vector<std::vector<double>>& u_batch, const std::vector<std::vector<double>>& v_batch,
+                         const std::vector<std::vector<double>>& w_batch,
+                         const std::vector<std::vector<std::complex<double>>>& visibilities_batch) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file for writing visibilities: " << filename << "\n";
+        return false;
+    }
+
+    file.write(VISIBILITY_MAGIC, sizeof(VISIBILITY_MAGIC));
+    writeValue(file, VISIBILITY_VERSION);
+    writeValue(file, static_cast<std::uint32_t>(VISIBILITY_RECORD_SIZE));
+    writeValue(file, static_cast<std::uint64_t>(visibilities_batch.size()));
+    for (const auto& visibilities : visibilities_batch) {
+        writeValue(file, static_cast<std::uint64_t>(visibilities.size()));
+    }
+
+    std::vector<double> records(RECORDS_PER_CHUNK * 5);
+    for (size_t d = 0; d < visibilities_batch.size(); ++d) {
+        const size_t count = visibilities_batch[d].size();
+        for (size_t first = 0; first < count; first += RECORDS_PER_CHUNK) {
+            const size_t chunk = std::min(RECORDS_PER_CHUNK, count - first);
+            for (size_t k = 0; k < chunk; ++k) {
+                records[5 * k] = u_batch[d][first + k];
+                records[5 * k + 1] = v_batch[d][first + k];
+                records[5 * k + 2] = w_batch[d][first + k];
+                records[5 * k + 3] = visibilities_batch[d][first + k].real();
+                records[5 * k + 4] = visibilities_batch[d][first + k].imag();
+            }
+            file.write(reinterpret_cast<const char*>(records.data()), chunk * VISIBILITY_RECORD_SIZE);
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+VisibilityStream::~VisibilityStream() {
+    stop();
+}
+
+/**
+ * @brief Open a visibility file and read its header.
+ *
+ * @param filename Path of the file.
+ * @return true if the header is valid and the file holds all records it announces.
+ */
+bool VisibilityStream::open(const std::string& filename) {
+    filename_ = filename;
+    file_.open(filename, std::ios::binary);
+    if (!file_.is_open()) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return false;
+    }
+
+    char magic[8];
+    std::uint32_t version, record_size;
+    std::uint64_t num_directions;
+    if (!file_.read(magic, sizeof(magic)) || std::memcmp(magic, VISIBILITY_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(file_, version) || version != VISIBILITY_VERSION ||
+        !readValue(file_, record_size) || record_size != VISIBILITY_RECORD_SIZE ||
+        !readValue(file_, num_directions) || num_directions > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+        std::cerr << "Error: Not a visibility file: " << filename << "\n";
+        return false;
+    }
+
+    counts_.resize(num_directions);
+    for (auto& count : counts_) {
+        if (!readValue(file_, count)) {
+            std::cerr << "Error reading visibility file header: " << filename << "\n";
+            return false;
+        }
+    }
+
+    offsets_.resize(num_directions);
+    std::uint64_t offset = static_cast<std::uint64_t>(file_.tellg());
+    for (size_t d = 0; d < counts_.size(); ++d) {
+        offsets_[d] = offset;
+        offset += counts_[d] * VISIBILITY_RECORD_SIZE;
+    }
+
+    file_.seekg(0, std::ios::end);
+    if (static_cast<std::uint64_t>(file_.tellg()) < offset) {
+        std::cerr << "Error: Visibility file is truncated: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Total number of visibilities in the file.
+ */
+std::uint64_t VisibilityStream::totalVisibilities() const {
+    std::uint64_t total = 0;
+    for (std::uint64_t count : counts_) {
+        total += count;
+    }
+    return total;
+}
+
+/**
+ * @brief Largest u of a direction, found with a streaming pass over its records (call before start).
+ *
+ * @param direction Index of the direction.
+ * @return double The maximum u coordinate (0 for an empty direction).
+ */
+double VisibilityStream::maxU(int direction) {
+    std::vector<char> buffer(RECORDS_PER_CHUNK * VISIBILITY_RECORD_SIZE);
+    double max_u = -std::numeric_limits<double>::infinity();
+    file_.clear();
+    file_.seekg(offsets_[direction]);
+    for (size_t first = 0; first < counts_[direction]; first += RECORDS_PER_CHUNK) {
+        const size_t chunk = std::min<size_t>(RECORDS_PER_CHUNK, counts_[direction] - first);
+        file_.read(buffer.data(), chunk * VISIBILITY_RECORD_SIZE);
+        for (size_t k = 0; k < chunk; ++k) {
+            max_u = std::max(max_u, recordValue(buffer.data() + k * VISIBILITY_RECORD_SIZE, 0));
+        }
+    }
+    return counts_[direction] > 0 ? max_u : 0.0;
+}
+
+/**
+ * @brief Allocate the two blocks and start the reader thread.
+ *
+ * @param block_visibilities Maximum number of visibilities per block.
+ */
+void VisibilityStream::start(size_t block_visibilities) {
+    block_visibilities_ = std::max<size_t>(block_visibilities, 1);
+    read_buffer_.resize(block_visibilities_ * VISIBILITY_RECORD_SIZE);
+    for (VisibilityBlock& block : blocks_) {
+        block.u.resize(block_visibilities_);
+        block.v.resize(block_visibilities_);
+        block.visibilities.resize(block_visibilities_);
+    }
+    file_.clear();
+    thread_ = std::thread([this]() { run(); });
+}
+
+/**
+ * @brief Return the previous block to the reader and wait for the next filled one.
+ *
+ * @return const VisibilityBlock* The next block, or nullptr when the file is exhausted or a read failed.
+ */
+const VisibilityBlock* VisibilityStream::next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (consumer_block_ >= 0) {
+        consumer_block_ = -1;
+        changed_.notify_all();
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    changed_.wait(lock, [this]() { return filled_[next_block_] || finished_; });
+    auto stop = std::chrono::high_resolution_clock::now();
+    consumer_wait_ms_ += std::chrono::duration<double, std::milli>(stop - start).count();
+
+    if (!filled_[next_block_]) {
+        return nullptr;
+    }
+    filled_[next_block_] = false;
+    consumer_block_ = next_block_;
+    next_block_ ^= 1;
+    return &blocks_[consumer_block_];
+}
+
+/**
+ * @brief Reader thread: fill the two blocks in turn until every direction is read.
+ */
+void VisibilityStream::run() {
+    int slot = 0;
+    for (int d = 0; d < numDirections(); ++d) {
+        for (size_t first = 0; first < counts_[d]; first += block_visibilities_) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                changed_.wait(lock, [this, slot]() { return stopping_ || (!filled_[slot] && consumer_block_ != slot); });
+                if (stopping_) {
+                    return;
+                }
+            }
+
+            const size_t count = std::min<size_t>(block_visibilities_, counts_[d] - first);
+            const bool ok = readBlock(blocks_[slot], d, first, count);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ok) {
+                std::cerr << "Error reading visibility file: " << filename_ << "\n";
+                failed_ = true;
+                finished_ = true;
+                changed_.notify_all();
+                return;
+            }
+            filled_[slot] = true;
+            ++blocks_read_;
+            changed_.notify_all();
+            slot ^= 1;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    changed_.notify_all();
+}
+
+/**
+ * @brief Read count records of a direction and split them into the u, v and visibility arrays of a block.
+ */
+bool VisibilityStream::readBlock(VisibilityBlock& block, int direction, size_t first, size_t count) {
+    file_.seekg(offsets_[direction] + first * VISIBILITY_RECORD_SIZE);
+    if (!file_.read(read_buffer_.data(), count * VISIBILITY_RECORD_SIZE)) {
+        return false;
+    }
+    for (size_t k = 0; k < count; ++k) {
+        const char* record = read_buffer_.data() + k * VISIBILITY_RECORD_SIZE;
+        block.u[k] = recordValue(record, 0);
+        block.v[k] = recordValue(record, 1);
+        block.visibilities[k] = std::complex<double>(recordValue(record, 3), recordValue(record, 4));
+    }
+    block.direction = direction;
+    block.count = count;
+    return true;
+}
+
+/**
+ * @brief Stop the reader thread.
+ */
+void VisibilityStream::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+/**
+ * @brief Block size of a stream that fits a memory budget.
+ *
+ * The budget is spent on the grids and images of all directions first; the rest
+ * sizes the two stream blocks and the read buffer (see bytesPerBufferedVisibility).
+ *
+ * @param stream The opened stream.
+ * @param image_size Size of the output image.
+ * @param memory_budget_mb Memory budget in MB.
+ * @return size_t Visibilities per block, or 0 if the grids and images alone exceed the budget.
+ */
+size_t streamBlockVisibilities(const VisibilityStream& stream, int image_size, size_t memory_budget_mb) {
+    const size_t num_cells = static_cast<size_t>(image_size) * image_size;
+    const size_t image_bytes = stream.numDirections() * num_cells * (sizeof(std::complex<double>) + sizeof(double));
+    const size_t budget_bytes = memory_budget_mb << 20;
+    if (image_bytes >= budget_bytes) {
+        std::cerr << "Error: Memory budget of " << memory_budget_mb << " MB does not fit the grids and images of "
+                  << stream.numDirections() << " directions (" << (image_bytes >> 20) + 1 << " MB).\n";
+        return 0;
+    }
+
+    size_t largest_direction = 0;
+    for (int d = 0; d < stream.numDirections(); ++d) {
+        largest_direction = std::max(largest_direction, stream.numVisibilities(d));
+    }
+    return std::min((budget_bytes - image_bytes) / VisibilityStream::bytesPerBufferedVisibility(),
+                    std::max<size_t>(largest_direction, 1));
+}
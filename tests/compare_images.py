@@ -4,11 +4,13 @@ import numpy as np
 import pandas as pd
 import matplotlib.pyplot as plt
 
-def run_cuda_program(input_file, directions_file, output_dir):
-    """ Run the CUDA program with specified inputs and output directory. """
+def run_cuda_program(input_file, directions_file, output_dir, backend='cuda', precision='double'):
+    """ Run the RadioImager program with specified inputs, backend, precision and output directory. """
     cuda_executable = './build/RadioImager'
     args = [
         cuda_executable,
+        f'--backend={backend}',
+        f'--precision={precision}',
         f'--input={input_file}',
         f'--directions={directions_file}',
         '--use_predefined_params=true',
@@ -45,6 +47,34 @@ def plot_images(image_dir, num_images, prefix):
         
         print(f'{prefix} Image {i} saved as PNG.')
 
+def compare_backends(cuda_dir, cpu_dir, num_images):
+    """ Compare images generated by the CUDA and native CPU backends of RadioImager. """
+    for i in range(num_images):
+        cuda_image = np.loadtxt(f'{cuda_dir}/image_data_gpu_{i}.csv', delimiter=',')
+        cpu_image = np.loadtxt(f'{cpu_dir}/image_data_gpu_{i}.csv', delimiter=',')
+
+        max_difference = np.max(np.abs(cuda_image - cpu_image))
+        print(f'CPU backend Image {i} max difference from CUDA: {max_difference}')
+        if max_difference < 1e-6:
+            print(f'CPU backend Image {i} matches CUDA.')
+        else:
+            print(f'CPU backend Image {i} does not match CUDA.')
+
+def compare_precisions(double_dir, reduced_dir, precision, tolerance, num_images):
+    """ Compare images imaged in float or mixed precision with the double precision images. """
+    for i in range(num_images):
+        double_image = np.loadtxt(f'{double_dir}/image_data_gpu_{i}.csv', delimiter=',')
+        reduced_image = np.loadtxt(f'{reduced_dir}/image_data_gpu_{i}.csv', delimiter=',')
+
+        difference = reduced_image - double_image
+        max_difference = np.max(np.abs(difference))
+        rms_difference = np.sqrt(np.mean(difference ** 2))
+        print(f'{precision} precision Image {i} max difference: {max_difference}, RMS difference: {rms_difference}')
+        if max_difference < tolerance:
+            print(f'{precision} precision Image {i} is within tolerance ({tolerance}).')
+        else:
+            print(f'{precision} precision Image {i} exceeds tolerance ({tolerance}).')
+
 def compare_images(cuda_dir, python_dir, diff_dir, num_images):
     """ Compare images generated by CUDA and Python implementations and save the differences as PNG files. """
     os.makedirs(diff_dir, exist_ok=True)
@@ -72,6 +102,9 @@ def compare_images(cuda_dir, python_dir, diff_dir, num_images):
 def main():
     data_dir = 'tests/data'
     cuda_output_dir = 'tests/output/cuda'
+    cpu_output_dir = 'tests/output/cpu'
+    float_output_dir = 'tests/output/float'
+    mixed_output_dir = 'tests/output/mixed'
     python_output_dir = 'tests/output/python'
     diff_output_dir = 'tests/output/differences'
     
@@ -82,6 +115,16 @@ def main():
     run_cuda_program(input_file, directions_file, cuda_output_dir)
     plot_images(f'{cuda_output_dir}/images_gpu', 10, 'image_data_gpu_')  # Adjust the number of images as needed
 
+    # Run the native CPU backend and check it against the CUDA output
+    run_cuda_program(input_file, directions_file, cpu_output_dir, backend='cpu')
+    compare_backends(f'{cuda_output_dir}/images_gpu', f'{cpu_output_dir}/images_gpu', 10)
+
+    # Run in mixed and float precision and check the error against double precision
+    run_cuda_program(input_file, directions_file, mixed_output_dir, precision='mixed')
+    compare_precisions(f'{cuda_output_dir}/images_gpu', f'{mixed_output_dir}/images_gpu', 'mixed', 1e-5, 10)
+    run_cuda_program(input_file, directions_file, float_output_dir, precision='float')
+    compare_precisions(f'{cuda_output_dir}/images_gpu', f'{float_output_dir}/images_gpu', 'float', 1e-2, 10)
+
     # Optionally run Python program and compare images
     run_python_script(input_file, directions_file, python_output_dir)
     compare_images(f'{cuda_output_dir}/images_gpu', f'{python_output_dir}/images', diff_output_dir, 10)  # Adjust the number of images as needed